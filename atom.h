@@ -4,36 +4,881 @@
 
 #pragma once
 
-#include <shared_mutex>
+#include <mutex>
+#include <atomic>
 #include <memory>
 #include <functional>
+#include <vector>
 #include <unordered_map>
+#include <algorithm>
 #include <concepts>
 #include <cstdint>
 #include <type_traits>
+#include <optional>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <stdexcept>
+#include <coroutine>
+#include <utility>
+#include <chrono>
+#include <climits>
 
-template <typename T>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "executor.h"
+#include "inplace_function.h"
+
+// Bytes of capture a listener callback may hold inline; larger captures fail to
+// compile. Define before including to change it.
+#ifndef ATOM_LISTENER_CAPACITY
+#define ATOM_LISTENER_CAPACITY 64
+#endif
+
+// Equality policies decide whether a write changes the value and so whether the
+// write is skipped. key() computes a summary that pointer-published storage
+// caches beside each version; same() compares two values given their keys.
+struct DefaultEquality {
+    struct Key {};
+
+    template <typename T>
+    static Key key(const T&) { return {}; }
+
+    template <typename T>
+    static bool same(const T& a, Key, const T& b, Key) {
+        if constexpr (std::equality_comparable<T>) {
+            return a == b;
+        } else {
+            return false;
+        }
+    }
+};
+
+// Every write counts as a change; no comparison is made.
+struct IdentityEquality {
+    struct Key {};
+
+    template <typename T>
+    static Key key(const T&) { return {}; }
+
+    template <typename T>
+    static bool same(const T& a, Key, const T& b, Key) { return &a == &b; }
+};
+
+// Compares a single version or etag member, e.g. FieldEquality<&Config::revision>.
+template <auto Field>
+struct FieldEquality {
+    struct Key {};
+
+    template <typename T>
+    static Key key(const T&) { return {}; }
+
+    template <typename T>
+    static bool same(const T& a, Key, const T& b, Key) { return a.*Field == b.*Field; }
+};
+
+// Caches a 64-bit content hash of each version. Differing hashes settle
+// inequality with one integer compare; equal hashes are confirmed with
+// operator==. A value that carries its own hash, through a `hash()` member,
+// supplies it directly. Otherwise std::hash<T> runs over the whole value on every
+// write, which for large values costs as much as the compare it replaces.
+struct HashEquality {
+    using Key = uint64_t;
+
+    template <typename T>
+    static Key key(const T& value) {
+        if constexpr (requires { { value.hash() } -> std::convertible_to<uint64_t>; }) {
+            return value.hash();
+        } else {
+            return std::hash<T>{}(value);
+        }
+    }
+
+    template <typename T>
+    static bool same(const T& a, Key ka, const T& b, Key kb) { return ka == kb && a == b; }
+};
+
+template <typename T, typename Equal = DefaultEquality>
 class Atom;
 
+template <typename T, typename Equal = DefaultEquality>
+class Subscription;
+
+class Transaction;
+
+// Contention counters for Atom::updateOptimistic().
+struct OptimisticStats {
+    uint64_t commits;    // Optimistic updates that installed a new value
+    uint64_t conflicts;  // Optimistic updates that lost at least one race
+    uint64_t retries;    // Extra updater runs caused by lost races
+};
+
+// How Atom::waitUntil() waits between checks of its predicate.
+enum class WaitStrategy {
+    Park,          // Sleep in the kernel until the next write
+    Spin,          // Busy-poll the change counter; for threads on isolated cores
+    SpinThenPark,  // Busy-poll briefly, then park
+};
+
+// What a queued subscription does when a write finds its buffer full.
+enum class OverflowPolicy {
+    Block,       // The writer waits for the consumer to free a slot
+    DropOldest,  // The oldest undelivered value is discarded and counted
+    Fail,        // The value is not queued and the write throws QueueOverflow
+};
+
+// Thrown by a write after its notification wave when a queued subscription with
+// OverflowPolicy::Fail had no room. The value itself is committed and every
+// other listener has been notified. One thrown out of a listener, say by its
+// own write to another atom, goes to onError like any other exception.
+struct QueueOverflow : std::runtime_error {
+    QueueOverflow() : std::runtime_error("queued subscription buffer is full") {}
+};
+
+namespace detail {
+
+// Atomically published shared_ptr. Uses std::atomic<std::shared_ptr> where the
+// standard library provides it; falls back to the shared_ptr atomic free
+// functions otherwise, and under ThreadSanitizer, which does not understand the
+// libstdc++ implementation's internal lock bit.
+#if defined(__has_feature)
+#  if __has_feature(thread_sanitizer)
+#    define ATOM_TSAN 1
+#  endif
+#endif
+#if defined(__SANITIZE_THREAD__)
+#  define ATOM_TSAN 1
+#endif
+
+template <typename U>
+class AtomicSharedPtr {
+public:
+    explicit AtomicSharedPtr(std::shared_ptr<U> initial) : ptr_(std::move(initial)) {}
+
+#if defined(__cpp_lib_atomic_shared_ptr) && !defined(ATOM_TSAN)
+    std::shared_ptr<U> load() const { return ptr_.load(std::memory_order_acquire); }
+    void store(std::shared_ptr<U> next) { ptr_.store(std::move(next), std::memory_order_release); }
+private:
+    std::atomic<std::shared_ptr<U>> ptr_;
+#else
+    std::shared_ptr<U> load() const { return std::atomic_load_explicit(&ptr_, std::memory_order_acquire); }
+    void store(std::shared_ptr<U> next) { std::atomic_store_explicit(&ptr_, std::move(next), std::memory_order_release); }
+private:
+    std::shared_ptr<U> ptr_;
+#endif
+};
+
+// Shares a committed version with snapshot listeners. Pointer-published versions
+// are passed through; inline versions are small enough to copy once per wave.
 template <typename T>
+std::shared_ptr<const T> shareVersion(const std::shared_ptr<const T>& version) {
+    return version;
+}
+
+template <typename T>
+std::shared_ptr<const T> shareVersion(const std::optional<T>& version) {
+    return std::make_shared<const T>(*version);
+}
+
+// Hands task to executor, or runs it on the calling thread when there is none.
+inline void runOn(const std::shared_ptr<Executor>& executor, std::function<void()> task) {
+    if (executor) {
+        executor->post(std::move(task));
+    } else {
+        task();
+    }
+}
+
+struct MailboxCounters {
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> conflated{0};
+};
+
+// Latest-value mailbox with a pending flag: at most one drain task is in flight,
+// and a value put while one is pending replaces the undelivered value.
+template <typename Version>
+class ConflatingMailbox : public std::enable_shared_from_this<ConflatingMailbox<Version>>, public MailboxCounters {
+public:
+    ConflatingMailbox(std::function<void(const Version&)> deliver, std::shared_ptr<Executor> executor)
+        : deliver_(std::move(deliver)), executor_(std::move(executor)) {}
+
+    void put(const Version& version) {
+        {
+            std::unique_lock lock(mutex_);
+            if (latest_) conflated.fetch_add(1, std::memory_order_relaxed);
+            latest_ = version;
+            if (scheduled_) return;
+            scheduled_ = true;
+        }
+        runOn(executor_, [self = this->shared_from_this()] { self->drain(); });
+    }
+
+private:
+    // Keeps delivering until the mailbox is empty, so a value put during a
+    // delivery is picked up without scheduling a second drain.
+    void drain() {
+        for (;;) {
+            Version version;
+            {
+                std::unique_lock lock(mutex_);
+                if (!latest_) {
+                    scheduled_ = false;
+                    return;
+                }
+                version = std::move(latest_);
+                latest_ = Version{};
+            }
+            deliver_(version);
+            delivered.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    std::mutex mutex_;
+    Version latest_{};
+    bool scheduled_{false};
+    std::function<void(const Version&)> deliver_;
+    std::shared_ptr<Executor> executor_;
+};
+
+// Parks the calling thread while word still holds `seen`, for at most timeout
+// (forever when negative). Uses a futex on Linux; elsewhere it sleeps briefly,
+// so callers must re-check. May return spuriously.
+inline void parkWord(std::atomic<uint32_t>& word, uint32_t seen, std::chrono::nanoseconds timeout) {
+#if defined(__linux__)
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+    timespec ts{};
+    timespec* tsp = nullptr;
+    if (timeout.count() >= 0) {
+        ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+        ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+        tsp = &ts;
+    }
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, seen, tsp, nullptr, 0);
+#else
+    (void)seen;
+    auto nap = std::chrono::nanoseconds(std::chrono::microseconds(50));
+    std::this_thread::sleep_for(timeout.count() >= 0 ? std::min(timeout, nap) : nap);
+#endif
+}
+
+inline void wakeWord(std::atomic<uint32_t>& word) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Exponential spin that falls back to yielding once the spin budget is spent.
+class Backoff {
+public:
+    void pause() {
+        if (step_ < kSpinSteps) {
+            for (uint32_t i = 0; i < (1u << step_); i++) cpuRelax();
+            step_++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    static constexpr uint32_t kSpinSteps = 10;
+    uint32_t step_{0};
+};
+
+struct OptimisticCounters {
+    std::atomic<uint64_t> commits{0};
+    std::atomic<uint64_t> conflicts{0};
+    std::atomic<uint64_t> retries{0};
+
+    // Records the outcome of one optimistic update that needed `attempts` runs.
+    void record(uint32_t attempts, bool committed) {
+        if (committed) commits.fetch_add(1, std::memory_order_relaxed);
+        if (attempts > 1) {
+            conflicts.fetch_add(1, std::memory_order_relaxed);
+            retries.fetch_add(attempts - 1, std::memory_order_relaxed);
+        }
+    }
+};
+
+struct QueueCounters {
+    explicit QueueCounters(size_t capacity) : capacity(capacity) {}
+
+    // Values queued but not yet taken by the consumer.
+    size_t depth() const {
+        auto t = tail.load(std::memory_order_relaxed);
+        auto h = head.load(std::memory_order_relaxed);
+        return t > h ? std::min(t - h, capacity) : 0;
+    }
+
+    const size_t capacity;
+    std::atomic<size_t> head{0};  // Next position to consume
+    std::atomic<size_t> tail{0};  // Next position to fill
+    std::atomic<size_t> highWater{0};
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> rejected{0};
+};
+
+// Lossless bounded ring buffer feeding one consumer. Each slot carries a
+// sequence number (Vyukov): a producer may fill the slot for position p once its
+// sequence equals 2p, and the consumer may take it once it equals 2p + 1. The
+// doubling keeps a full slot from looking free to the next lap when there is
+// only one slot. Writes
+// from different threads can notify concurrently, so producers claim positions
+// with a CAS on the tail; with one writer that CAS never fails. Only one drain
+// runs at a time, as in Strand.
+template <typename Version>
+class QueuedMailbox : public std::enable_shared_from_this<QueuedMailbox<Version>>, public QueueCounters {
+    struct Slot {
+        std::atomic<size_t> seq;
+        Version value{};
+    };
+
+public:
+    QueuedMailbox(size_t capacity, OverflowPolicy policy, std::function<void(const Version&)> deliver,
+                  std::shared_ptr<Executor> executor)
+        : QueueCounters(std::max<size_t>(capacity, 1)), policy_(policy), slots_(this->capacity),
+          deliver_(std::move(deliver)), executor_(std::move(executor)) {
+        for (size_t i = 0; i < slots_.size(); i++) slots_[i].seq.store(2 * i, std::memory_order_relaxed);
+    }
+
+    // Returns false, without queueing, under OverflowPolicy::Fail when the buffer
+    // is full.
+    bool put(const Version& version) {
+        auto pos = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& slot = slots_[pos % capacity];
+            auto seq = slot.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(2 * pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.value = version;
+                    slot.seq.store(2 * pos + 1, std::memory_order_release);
+                    recordDepth(pos + 1);
+                    break;
+                }
+            } else if (diff < 0) {
+                // The slot still holds position pos - capacity: full.
+                if (!overflow(slot, seq, pos - capacity)) return false;
+                pos = tail.load(std::memory_order_relaxed);
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        if (!scheduled_.exchange(true)) {
+            runOn(executor_, [self = this->shared_from_this()] { self->drain(); });
+        }
+        return true;
+    }
+
+private:
+    // Returns whether the producer should retry.
+    bool overflow(Slot& slot, size_t seq, size_t oldest) {
+        switch (policy_) {
+            case OverflowPolicy::Fail:
+                rejected.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            case OverflowPolicy::Block:
+                // A drain is pending or running while the buffer is non-empty.
+                if (seq == 2 * oldest + 1) {
+                    slot.seq.wait(seq, std::memory_order_acquire);
+                } else {
+                    cpuRelax();  // Another producer is still filling it
+                }
+                return true;
+            case OverflowPolicy::DropOldest: {
+                auto expected = oldest;
+                if (seq == 2 * oldest + 1 && head.compare_exchange_strong(expected, oldest + 1, std::memory_order_relaxed)) {
+                    slot.value = Version{};
+                    slot.seq.store(2 * (oldest + capacity), std::memory_order_release);
+                    dropped.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    cpuRelax();  // The consumer is taking it
+                }
+                return true;
+            }
+        }
+        return true;
+    }
+
+    void recordDepth(size_t filled) {
+        auto depth = filled - std::min(filled, head.load(std::memory_order_relaxed));
+        auto seen = highWater.load(std::memory_order_relaxed);
+        while (depth > seen && !highWater.compare_exchange_weak(seen, depth, std::memory_order_relaxed)) {}
+    }
+
+    // Producers dropping the oldest value race the consumer for it through the
+    // CAS on head; whoever wins owns the slot.
+    bool pop(Version& out) {
+        auto pos = head.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& slot = slots_[pos % capacity];
+            auto seq = slot.seq.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(2 * pos + 1);
+            if (diff < 0) return false;
+            if (diff > 0) {
+                pos = head.load(std::memory_order_relaxed);
+            } else if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                out = std::move(slot.value);
+                slot.value = Version{};
+                slot.seq.store(2 * (pos + capacity), std::memory_order_release);
+                if (policy_ == OverflowPolicy::Block) slot.seq.notify_all();
+                return true;
+            }
+        }
+    }
+
+    bool empty() const {
+        auto pos = head.load(std::memory_order_relaxed);
+        return slots_[pos % capacity].seq.load(std::memory_order_acquire) != 2 * pos + 1;
+    }
+
+    void drain() {
+        Version version;
+        for (;;) {
+            while (pop(version)) {
+                deliver_(version);
+                delivered.fetch_add(1, std::memory_order_relaxed);
+            }
+            version = Version{};
+            scheduled_.store(false);
+            // A put that saw scheduled_ still set relies on this re-check.
+            if (empty() || scheduled_.exchange(true)) return;
+        }
+    }
+
+    const OverflowPolicy policy_;
+    std::vector<Slot> slots_;
+    std::atomic<bool> scheduled_{false};
+    std::function<void(const Version&)> deliver_;
+    std::shared_ptr<Executor> executor_;
+};
+
+// Intrusive one-shot waiter for Atom::changed(). Lives in the awaiting
+// coroutine's frame and is linked into the atom's waiter stack while suspended.
+template <typename Version>
+struct ChangeWaiter {
+    virtual void wake(const Version& version) = 0;
+    ChangeWaiter* next{nullptr};
+
+protected:
+    ~ChangeWaiter() = default;
+};
+
+// Resumes a coroutine inline, or on executor when one is given.
+inline void resumeOn(const std::shared_ptr<Executor>& executor, std::coroutine_handle<> handle) {
+    if (executor) {
+        executor->post([handle] { handle.resume(); });
+    } else {
+        handle.resume();
+    }
+}
+
+// Per-thread state of the active Batch scopes.
+struct PendingFlush {
+    virtual ~PendingFlush() = default;
+    virtual void flush() = 0;
+};
+
+struct BatchState {
+    int depth{0};
+    std::vector<std::unique_ptr<PendingFlush>> pending;  // In first-write order
+    std::unordered_map<const void*, PendingFlush*> byAtom;
+
+    PendingFlush* find(const void* atom) const {
+        auto it = byAtom.find(atom);
+        return it == byAtom.end() ? nullptr : it->second;
+    }
+
+    void add(const void* atom, std::unique_ptr<PendingFlush> entry) {
+        byAtom.emplace(atom, entry.get());
+        pending.push_back(std::move(entry));
+    }
+};
+
+// Global version clock for transactions. Stamps hold (version << 1) | locked.
+inline std::atomic<uint64_t>& txClock() {
+    static std::atomic<uint64_t> clock{0};
+    return clock;
+}
+
+using TxStamp = std::atomic<uint64_t>;
+
+// Thrown inside a transaction body to abort and retry it.
+struct TxConflict {};
+
+inline BatchState& batchState() {
+    thread_local BatchState state;
+    return state;
+}
+
+// What dependency tracking (derived.h) needs from an atom without knowing T.
+class TrackedAtom {
+public:
+    virtual uint64_t trackedVersion() const = 0;
+    // Runs callback after every committed change until the result is destroyed.
+    virtual std::shared_ptr<void> onChange(InplaceFunction<void(), 32> callback) const = 0;
+    virtual std::shared_ptr<const TrackedAtom> trackedSelf() const = 0;
+
+protected:
+    ~TrackedAtom() = default;
+};
+
+// Told about every atom read on its thread while installed as activeTracker().
+class DependencyTracker {
+public:
+    virtual void track(const TrackedAtom& atom) = 0;
+
+protected:
+    ~DependencyTracker() = default;
+};
+
+// Null except while a derived atom's function runs, so a read outside one
+// costs a single thread-local load.
+inline DependencyTracker*& activeTracker() {
+    thread_local DependencyTracker* tracker = nullptr;
+    return tracker;
+}
+
+template <typename Equal, typename T>
+bool sameValue(const T& a, const T& b) {
+    return Equal::same(a, Equal::key(a), b, Equal::key(b));
+}
+
+// Default storage: each version is a heap-allocated immutable T, together with its
+// equality key, published with a single pointer store. Readers never block and
+// never copy.
+template <typename T, typename Equal>
+class SnapshotStorage {
+    using Key = decltype(Equal::key(std::declval<const T&>()));
+
+    struct Entry {
+        explicit Entry(T v) : value(std::move(v)), key(Equal::key(value)) {}
+        Entry(T v, Key k) : value(std::move(v)), key(k) {}
+
+        T value;
+        [[no_unique_address]] Key key;
+    };
+
+    // Aliases the value inside its entry, so handing out versions costs nothing.
+    static std::shared_ptr<const T> view(std::shared_ptr<const Entry> entry) {
+        const T* value = &entry->value;
+        return std::shared_ptr<const T>(std::move(entry), value);
+    }
+
+    static bool same(const Entry& a, const Entry& b) { return Equal::same(a.value, a.key, b.value, b.key); }
+
+public:
+    using Version = std::shared_ptr<const T>;
+
+    explicit SnapshotStorage(T initial) : current_(std::make_shared<const Entry>(std::move(initial))) {}
+
+    T load() const { return current_.load()->value; }
+    Version current() const { return view(current_.load()); }
+    std::shared_ptr<const T> snapshot() const { return view(current_.load()); }
+
+    // Both return an empty Version when the equality skip applies. The new key is
+    // computed before taking the write lock.
+    Version replace(T value) {
+        auto next = std::make_shared<const Entry>(std::move(value));
+        std::unique_lock lock(write_mutex_);
+        if (same(*next, *current_.load())) return {};
+        current_.store(next);
+        return view(std::move(next));
+    }
+
+    template <typename F>
+    Version modify(F&& updater) {
+        std::unique_lock lock(write_mutex_);
+        auto current = current_.load();
+        auto next = std::make_shared<const Entry>(updater(current->value));
+        if (same(*next, *current)) return {};
+        current_.store(next);
+        return view(std::move(next));
+    }
+
+    // Runs the updater against the current version outside the write lock, then
+    // commits only if that version is still current. Version identity is the
+    // pointer: the held snapshot keeps its address from being reused.
+    template <typename F>
+    Version modifyOptimistic(F&& updater, OptimisticCounters& counters) {
+        Backoff backoff;
+        for (uint32_t attempts = 1;; attempts++) {
+            auto current = current_.load();
+            auto next = std::make_shared<const Entry>(updater(current->value));
+            if (same(*next, *current)) {
+                counters.record(attempts, false);
+                return {};
+            }
+            {
+                std::unique_lock lock(write_mutex_);
+                if (current_.load() == current) {
+                    current_.store(next);
+                    counters.record(attempts, true);
+                    return view(std::move(next));
+                }
+            }
+            backoff.pause();
+        }
+    }
+
+    // Published versions are shared with readers and cannot be edited, so the
+    // mutator edits a private copy that becomes the next version.
+    template <typename F>
+    Version mutate(F&& mutator) {
+        std::unique_lock lock(write_mutex_);
+        auto current = current_.load();
+        auto next = std::make_shared<Entry>(current->value, current->key);
+        if (!mutator(next->value)) return {};
+        next->key = Equal::key(next->value);
+        current_.store(next);
+        return view(std::move(next));
+    }
+
+private:
+    std::mutex write_mutex_;
+    AtomicSharedPtr<const Entry> current_;
+};
+
+// Sequence lock for small trivially copyable values. The value is kept in
+// acquire/release atomic words (plain moves on x86) so readers are race-free
+// without fences: a read is two sequence loads around a word copy and never
+// writes shared memory. Writers are serialised by write_mutex_ and hold the
+// sequence odd while storing.
+template <typename T, typename Equal>
+class SeqlockStorage {
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+public:
+    using Version = std::optional<T>;
+
+    explicit SeqlockStorage(T initial) { write(initial); }
+
+    T load() const {
+        uint64_t seq;
+        return load(seq);
+    }
+
+    Version current() const { return load(); }
+
+    // Consistent read that also reports the sequence it was read at.
+    T load(uint64_t& seq) const {
+        uint64_t words[kWords];
+        for (;;) {
+            seq = seq_.load(std::memory_order_acquire);
+            if (seq & 1) continue;
+            for (size_t i = 0; i < kWords; i++) {
+                words[i] = words_[i].load(std::memory_order_acquire);
+            }
+            if (seq_.load(std::memory_order_relaxed) == seq) break;
+        }
+        alignas(T) unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, words, sizeof(T));
+        return *std::launder(reinterpret_cast<const T*>(bytes));
+    }
+
+    std::shared_ptr<const T> snapshot() const { return std::make_shared<const T>(load()); }
+
+    Version replace(T value) {
+        std::unique_lock lock(write_mutex_);
+        if (sameValue<Equal>(value, load())) return {};
+        write(value);
+        return value;
+    }
+
+    template <typename F>
+    Version modify(F&& updater) {
+        std::unique_lock lock(write_mutex_);
+        auto current = load();
+        T newValue = updater(current);
+        if (sameValue<Equal>(newValue, current)) return {};
+        write(newValue);
+        return newValue;
+    }
+
+    // The sequence number doubles as the version stamp.
+    template <typename F>
+    Version modifyOptimistic(F&& updater, OptimisticCounters& counters) {
+        Backoff backoff;
+        for (uint32_t attempts = 1;; attempts++) {
+            uint64_t seq;
+            T current = load(seq);
+            T newValue = updater(current);
+            if (sameValue<Equal>(newValue, current)) {
+                counters.record(attempts, false);
+                return {};
+            }
+            {
+                std::unique_lock lock(write_mutex_);
+                if (seq_.load(std::memory_order_relaxed) == seq) {
+                    write(newValue);
+                    counters.record(attempts, true);
+                    return newValue;
+                }
+            }
+            backoff.pause();
+        }
+    }
+
+    template <typename F>
+    Version mutate(F&& mutator) {
+        std::unique_lock lock(write_mutex_);
+        T value = load();
+        if (!mutator(value)) return {};
+        write(value);
+        return value;
+    }
+
+private:
+    void write(const T& value) {
+        uint64_t words[kWords] = {};
+        std::memcpy(words, &value, sizeof(T));
+        auto seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        for (size_t i = 0; i < kWords; i++) {
+            words_[i].store(words[i], std::memory_order_release);
+        }
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    std::mutex write_mutex_;
+    std::atomic<uint64_t> seq_{0};
+    std::atomic<uint64_t> words_[kWords];
+};
+
+// Lock-free storage for types std::atomic handles natively. set() and update()
+// are compare-exchange loops, so writers never serialise on a lock; the updater
+// may run more than once when writers race. A write the equality policy calls
+// the same is not stored, as with the other storage policies.
+template <typename T, typename Equal>
+class AtomicStorage {
+public:
+    using Version = std::optional<T>;
+
+    explicit AtomicStorage(T initial) : value_(initial) {}
+
+    T load() const { return value_.load(std::memory_order_acquire); }
+    Version current() const { return load(); }
+    std::shared_ptr<const T> snapshot() const { return std::make_shared<const T>(load()); }
+
+    Version replace(T value) {
+        auto current = value_.load(std::memory_order_acquire);
+        for (;;) {
+            if (sameValue<Equal>(value, current)) return {};
+            if (value_.compare_exchange_weak(current, value, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return value;
+            }
+        }
+    }
+
+    template <typename F>
+    Version modify(F&& updater) {
+        auto current = value_.load(std::memory_order_acquire);
+        for (;;) {
+            T newValue = updater(current);
+            if (sameValue<Equal>(newValue, current)) return {};
+            if (value_.compare_exchange_weak(current, newValue, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return newValue;
+            }
+        }
+    }
+
+    // modify() is already optimistic; this variant counts failed exchanges and
+    // backs off between attempts.
+    template <typename F>
+    Version modifyOptimistic(F&& updater, OptimisticCounters& counters) {
+        Backoff backoff;
+        auto current = value_.load(std::memory_order_acquire);
+        for (uint32_t attempts = 1;; attempts++) {
+            T newValue = updater(current);
+            if (sameValue<Equal>(newValue, current)) {
+                counters.record(attempts, false);
+                return {};
+            }
+            if (value_.compare_exchange_weak(current, newValue, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                counters.record(attempts, true);
+                return newValue;
+            }
+            backoff.pause();
+        }
+    }
+
+    template <typename F>
+    Version mutate(F&& mutator) {
+        auto current = value_.load(std::memory_order_acquire);
+        for (;;) {
+            T value = current;
+            if (!mutator(value)) return {};
+            if (value_.compare_exchange_weak(current, value, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return value;
+            }
+        }
+    }
+
+private:
+    std::atomic<T> value_;
+};
+
+template <typename T>
+constexpr bool isAlwaysLockFree() {
+    if constexpr (std::is_trivially_copyable_v<T> && std::is_copy_assignable_v<T>) {
+        return std::atomic<T>::is_always_lock_free;
+    } else {
+        return false;
+    }
+}
+
+template <typename T>
+inline constexpr bool useAtomic = isAlwaysLockFree<T>();
+
+// Values up to this size use the sequence lock; larger ones are cheaper to publish
+// by pointer than to copy on every read.
+inline constexpr size_t kSeqlockMaxSize = 256;
+
+template <typename T>
+inline constexpr bool useSeqlock = std::is_trivially_copyable_v<T> && sizeof(T) <= kSeqlockMaxSize;
+
+template <typename T, typename Equal>
+using StorageFor = std::conditional_t<useAtomic<T>, AtomicStorage<T, Equal>,
+                   std::conditional_t<useSeqlock<T>, SeqlockStorage<T, Equal>, SnapshotStorage<T, Equal>>>;
+
+// Names a listener: its slot in the atom's slot map plus the slot's generation
+// when the listener was added, so a stale handle never removes a later occupant.
+struct ListenerHandle {
+    uint32_t slot;
+    uint32_t generation;
+};
+
+} // namespace detail
+
+template <typename T, typename Equal>
 class Subscription {
 public:
-    Subscription(std::weak_ptr<Atom<T>> owner, uint64_t id) : owner_(std::move(owner)), id_(id) {}
+    Subscription(std::weak_ptr<Atom<T, Equal>> owner, detail::ListenerHandle handle) : owner_(std::move(owner)), handle_(handle) {}
     ~Subscription() {
         if (auto atom = owner_.lock()) {
-            std::unique_lock lock(atom->mutex_);
-            atom->listeners_.erase(id_);
+            atom->removeListener(handle_);
         }
     }
 
-    Subscription(Subscription&& other) noexcept : owner_(std::move(other.owner_)), id_(other.id_) {
-        other.id_ = 0;
-    }
+    Subscription(Subscription&& other) noexcept : owner_(std::move(other.owner_)), handle_(other.handle_) {}
 
     void unsubscribe() {
         if (auto atom = owner_.lock()) {
-            std::unique_lock lock(atom->mutex_);
-            atom->listeners_.erase(id_);
+            atom->removeListener(handle_);
         }
         owner_.reset();
     }
@@ -42,14 +887,12 @@ public:
         if (this != &other) {
             // Unsubscribe from current
             if (auto atom = owner_.lock()) {
-                std::unique_lock lock(atom->mutex_);
-                atom->listeners_.erase(id_);
+                atom->removeListener(handle_);
             }
 
             // Steal from other
             owner_ = std::move(other.owner_);
-            id_ = other.id_;
-            other.id_ = 0;
+            handle_ = other.handle_;
         }
 
         return *this;
@@ -58,78 +901,468 @@ public:
     Subscription(const Subscription&) = delete;
     Subscription& operator=(const Subscription&) = delete;
 private:
-    std::weak_ptr<Atom<T>> owner_;
-    uint64_t id_;
+    std::weak_ptr<Atom<T, Equal>> owner_;
+    detail::ListenerHandle handle_;
 };
 
-template <typename T>
-class Atom: public std::enable_shared_from_this<Atom<T>> {
+template <typename T, typename Equal = DefaultEquality>
+class ConflatedSubscription {
+public:
+    ConflatedSubscription(Subscription<T, Equal> subscription, std::shared_ptr<detail::MailboxCounters> counters)
+        : subscription_(std::move(subscription)), counters_(std::move(counters)) {}
+
+    // Stops new values; a delivery already handed to the executor may still run.
+    void unsubscribe() { subscription_.unsubscribe(); }
+
+    uint64_t delivered() const { return counters_->delivered.load(std::memory_order_relaxed); }
+    uint64_t conflated() const { return counters_->conflated.load(std::memory_order_relaxed); }
+
+private:
+    Subscription<T, Equal> subscription_;
+    std::shared_ptr<detail::MailboxCounters> counters_;
+};
+
+template <typename T, typename Equal = DefaultEquality>
+class QueuedSubscription {
+public:
+    QueuedSubscription(Subscription<T, Equal> subscription, std::shared_ptr<detail::QueueCounters> counters)
+        : subscription_(std::move(subscription)), counters_(std::move(counters)) {}
+
+    // Stops new values; values already queued are still delivered.
+    void unsubscribe() { subscription_.unsubscribe(); }
+
+    size_t capacity() const { return counters_->capacity; }
+    size_t depth() const { return counters_->depth(); }
+    size_t highWaterMark() const { return counters_->highWater.load(std::memory_order_relaxed); }
+    uint64_t delivered() const { return counters_->delivered.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return counters_->dropped.load(std::memory_order_relaxed); }
+    uint64_t rejected() const { return counters_->rejected.load(std::memory_order_relaxed); }
+
+private:
+    Subscription<T, Equal> subscription_;
+    std::shared_ptr<detail::QueueCounters> counters_;
+};
+
+template <typename T, typename Equal>
+class Atom: public std::enable_shared_from_this<Atom<T, Equal>>, public detail::TrackedAtom {
     static_assert(std::is_copy_constructible_v<T>, "T must be copy constructible");
-    using ListenerMap = std::unordered_map<uint64_t, std::function<void(const T&)>>;
+public:
+    // Listener callables keep their capture inline, so a capture never needs a
+    // heap block of its own.
+    using Callback = InplaceFunction<void(const T&), ATOM_LISTENER_CAPACITY>;
+    using SnapshotCallback = InplaceFunction<void(const std::shared_ptr<const T>&), ATOM_LISTENER_CAPACITY>;
+
+private:
+    using Version = typename detail::StorageFor<T, Equal>::Version;
+    // Internal listeners (mailboxes, queues) that take the committed version itself.
+    // They return false when a queued subscription with OverflowPolicy::Fail had no
+    // room, which is how the write learns of its own overflow.
+    using VersionCallback = InplaceFunction<bool(const Version&), ATOM_LISTENER_CAPACITY>;
+
+    // Exactly one callback is set. Owned callables sit in one shared block each,
+    // so copying the list to publish it never copies a capture.
+    struct Listener {
+        uint32_t slot;
+        std::shared_ptr<const Callback> callback;
+        std::shared_ptr<const SnapshotCallback> snapshotCallback;
+        std::shared_ptr<const VersionCallback> versionCallback;
+        FunctionRef<void(const T&)> ref{};
+    };
+
+    // Immutable once published, so notify() iterates whatever list was current
+    // without copying or locking.
+    using ListenerList = std::vector<Listener>;
+
+    // The top-level listeners as published: the dense array of the slot map cut
+    // into immutable chunks of kChunk, indexed by immutable pages of kPage chunk
+    // pointers. Every subscribe and unsubscribe republishes, rebuilding at most
+    // two chunks and their pages and copying one pointer per page, i.e. one per
+    // kChunk * kPage listeners (13 at 50k listeners). Only that last part
+    // grows with n, so neither side pays for the whole array.
+    struct PublishedListeners {
+        static constexpr size_t kChunk = 64;
+        static constexpr size_t kPage = 64;
+        using Page = std::vector<std::shared_ptr<const ListenerList>>;
+
+        const ListenerList& chunk(size_t index) const { return *(*pages[index / kPage])[index % kPage]; }
+
+        std::vector<std::shared_ptr<const Page>> pages;
+        size_t size{0};
+    };
 
 public:
     struct PrivateKey {
     private:
         PrivateKey() = default;
-        template <typename U>
-        friend std::shared_ptr<Atom<U>> createAtom(U, std::function<void(std::exception_ptr)> onError);
+        template <typename U, typename E>
+        friend std::shared_ptr<Atom<U, E>> createAtom(U, std::function<void(std::exception_ptr)> onError);
     };
 
-    explicit Atom(PrivateKey, T initial, std::function<void(std::exception_ptr)> onError) : value_(std::move(initial)), on_error_(std::move(onError)) {}
+    explicit Atom(PrivateKey, T initial, std::function<void(std::exception_ptr)> onError)
+        : storage_(std::move(initial)), on_error_(std::move(onError)) {}
 
     T get() const {
-        std::shared_lock lock(mutex_);
-        return value_;
+        if (auto* tracker = detail::activeTracker()) [[unlikely]] tracker->track(*this);
+        return storage_.load();
+    }
+
+    // Current value as a shared immutable snapshot. Never blocks, and for values
+    // published by pointer never copies T; the snapshot stays valid after later
+    // writes replace it.
+    std::shared_ptr<const T> snapshot() const {
+        if (auto* tracker = detail::activeTracker()) [[unlikely]] tracker->track(*this);
+        return storage_.snapshot();
+    }
+
+    // Counts committed writes, so it changes whenever the value does. Read it
+    // before the value to tell later whether the value may have moved on.
+    uint64_t version() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    // Listeners currently registered; an executor group counts once.
+    size_t listenerCount() const {
+        return listener_count_.load(std::memory_order_relaxed);
     }
 
     void set(T value) {
-        ListenerMap snapshot;
-        T snapshotValue;
-        {
-            std::unique_lock lock(mutex_);
-            if constexpr (std::equality_comparable<T>) {
-                if (value == value_) return;
-            }
+        commit([&] { return storage_.replace(std::move(value)); });
+    }
 
-            if constexpr (std::is_move_assignable_v<T>) {
-                value_ = std::move(value);
-            } else {
-                value_ = value;
+    // For lock-free value types the updater may run more than once under contention.
+    void update(std::function<T(const T&)> updater) {
+        commit([&] { return storage_.modify(updater); });
+    }
+
+    // Runs the updater outside any lock against a version-stamped snapshot and
+    // commits only if no other write landed in between, retrying with backoff
+    // otherwise. Slow updaters never hold up set() or other writers; the updater
+    // may run several times.
+    void updateOptimistic(std::function<T(const T&)> updater) {
+        commit([&] { return storage_.modifyOptimistic(updater, optimistic_); });
+    }
+
+    // Flat-combining update for heavily contended atoms. Each caller publishes its
+    // updater to a per-atom list; whichever caller takes the combiner role applies
+    // every pending updater in arrival order as one write and sends one
+    // notification wave with the final value. Other callers return once their
+    // updater has been applied, possibly before that wave is delivered. An
+    // exception from an updater skips that updater and is rethrown to its caller.
+    void updateCombining(std::function<T(const T&)> updater) {
+        CombineRequest request;
+        request.updater = &updater;
+        auto* head = combine_head_.load(std::memory_order_relaxed);
+        do {
+            request.next = head;
+        } while (!combine_head_.compare_exchange_weak(head, &request, std::memory_order_release, std::memory_order_relaxed));
+
+        detail::Backoff backoff;
+        while (!request.done.load(std::memory_order_acquire)) {
+            bool combined = false;
+            commit([&]() -> Version {
+                std::unique_lock lock(combine_mutex_, std::try_to_lock);
+                if (!lock.owns_lock()) return {};
+                combined = true;
+                return combine();
+            });
+            if (combined) break;
+            backoff.pause();
+        }
+
+        if (request.error) std::rethrow_exception(request.error);
+    }
+
+    OptimisticStats optimisticStats() const {
+        return {
+            optimistic_.commits.load(std::memory_order_relaxed),
+            optimistic_.conflicts.load(std::memory_order_relaxed),
+            optimistic_.retries.load(std::memory_order_relaxed),
+        };
+    }
+
+    // Edits a copy of the current value. The mutator reports whether it changed
+    // anything, which replaces the equality check, so no comparison is made.
+    // The copy is still a full copy of T: readers may hold the current version,
+    // so it is never edited where it stands, and adding one entry to a large
+    // std::unordered_map costs O(n). Store a PersistentMap or PersistentVector
+    // (persistent.h) for O(log n) edits that share structure. Listeners are
+    // only notified when the mutator returns true.
+    void mutate(std::function<bool(T&)> mutator) {
+        commit([&] { return storage_.mutate(mutator); });
+    }
+
+    // Costs one allocation for the shared block that holds the callback, plus
+    // republishing the listener list (a chunk, the chunk pointers and the list
+    // header). Serial notification allocates nothing, except that snapshot
+    // listeners on inline storage share one heap copy of each version; parallel
+    // fan-out allocates its pool tasks.
+    Subscription<T, Equal> subscribe(Callback callback) {
+        return addListener({0, std::make_shared<const Callback>(std::move(callback)), nullptr, nullptr});
+    }
+
+    // Subscribes a callable owned by the caller. Nothing is copied or allocated
+    // for the callable (only the listener list is republished), so nothing
+    // keeps it alive: unsubscribe() stops new notifications, but one already
+    // running on another thread may still call it after unsubscribe() returns.
+    // The callable must outlive every write that could be notifying it, not
+    // just the subscription.
+    Subscription<T, Equal> subscribeRef(FunctionRef<void(const T&)> callback) {
+        return addListener({0, nullptr, nullptr, nullptr, callback});
+    }
+
+    // Runs the callback on executor instead of the writing thread. Listeners that
+    // share an executor on this atom form one group: a write costs the writer one
+    // lock-free enqueue per group, and each group runs its listeners for every
+    // value in the order the values were enqueued, never concurrently. A null
+    // executor delivers on the writing thread, as changed(nullptr) resumes there.
+    Subscription<T, Equal> subscribe(Callback callback, std::shared_ptr<Executor> executor) {
+        if (!executor) return subscribe(std::move(callback));
+        std::unique_lock lock(mutex_);
+        auto group = std::find_if(groups_.begin(), groups_.end(), [&](const ExecutorGroup& g) { return g.strand->executor() == executor; });
+        if (group == groups_.end()) {
+            auto listeners = std::make_shared<detail::AtomicSharedPtr<const ListenerList>>(std::make_shared<const ListenerList>());
+            auto strand = std::make_shared<detail::Strand<Version>>(std::move(executor), [listeners, onError = on_error_](const Version& version) {
+                deliver(*listeners->load(), version, onError);
+            });
+            auto handle = insertDense({0, nullptr, nullptr, std::make_shared<const VersionCallback>([strand](const Version& version) {
+                strand->push(version);
+                return true;
+            })});
+            group = groups_.insert(groups_.end(), {handle.slot, std::move(strand), std::move(listeners)});
+        }
+        auto handle = allocateSlot();
+        slots_[handle.slot].group = group->slot;
+        group->listeners->store(withListener(*group->listeners->load(), {handle.slot, std::make_shared<const Callback>(std::move(callback)), nullptr, nullptr}));
+        return Subscription<T, Equal>(this->shared_from_this(), handle);
+    }
+
+    // Like subscribe(), but the listener receives the committed version as a shared
+    // immutable snapshot it may keep. For values published by pointer this is the
+    // same object snapshot() returns, so nothing is copied.
+    Subscription<T, Equal> subscribeSnapshot(SnapshotCallback callback) {
+        return addListener({0, nullptr, std::make_shared<const SnapshotCallback>(std::move(callback)), nullptr});
+    }
+
+    // Subscription for slow listeners that only care about the latest value. Each
+    // write drops the value into the subscriber's mailbox and, unless a delivery is
+    // already pending, posts one drain task to executor. Values overwritten before
+    // they are delivered are dropped and counted. Deliveries for one subscriber
+    // never overlap. A null executor drains on the writing thread.
+    ConflatedSubscription<T, Equal> subscribeConflated(std::function<void(const T&)> callback,
+                                                        std::shared_ptr<Executor> executor) {
+        auto onError = on_error_;
+        auto mailbox = std::make_shared<detail::ConflatingMailbox<Version>>(
+            [callback = std::move(callback), onError](const Version& version) {
+                try {
+                    callback(*version);
+                } catch (...) {
+                    if (onError) onError(std::current_exception());
+                }
+            },
+            std::move(executor));
+        auto subscription = addListener({0, nullptr, nullptr, std::make_shared<const VersionCallback>([mailbox](const Version& version) {
+            mailbox->put(version);
+            return true;
+        })});
+        return ConflatedSubscription<T, Equal>(std::move(subscription), mailbox);
+    }
+
+    // Subscription that sees every value, in commit order, without the writer
+    // waiting on the callback. Each write copies the version into the
+    // subscriber's ring buffer of `capacity` values and, unless a drain is
+    // already pending, posts one drain task to executor; a null executor drains
+    // on the writing thread. When the buffer is full, policy decides between
+    // blocking the writer, dropping the oldest value, or failing the write with
+    // QueueOverflow. Block must not be used when the drain can only run on a
+    // thread that writes to this atom.
+    QueuedSubscription<T, Equal> subscribeQueued(std::function<void(const T&)> callback,
+                                                  std::shared_ptr<Executor> executor,
+                                                  size_t capacity, OverflowPolicy policy = OverflowPolicy::Block) {
+        auto onError = on_error_;
+        auto mailbox = std::make_shared<detail::QueuedMailbox<Version>>(
+            capacity, policy,
+            [callback = std::move(callback), onError](const Version& version) {
+                try {
+                    callback(*version);
+                } catch (...) {
+                    if (onError) onError(std::current_exception());
+                }
+            },
+            std::move(executor));
+        auto subscription = addListener({0, nullptr, nullptr, std::make_shared<const VersionCallback>([mailbox](const Version& version) {
+            return mailbox->put(version);
+        })});
+        return QueuedSubscription<T, Equal>(std::move(subscription), mailbox);
+    }
+
+    // Blocks until pred(value) holds for the current value and returns true, or
+    // returns false once timeout has passed without it holding. pred is checked
+    // against the value on entry and again after every notified write; no
+    // listener is registered. strategy picks how the thread waits in between.
+    template <typename Pred>
+    bool waitUntil(Pred&& pred, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max(),
+                   WaitStrategy strategy = WaitStrategy::SpinThenPark) {
+        using Clock = std::chrono::steady_clock;
+        bool forever = timeout == std::chrono::nanoseconds::max();
+        auto deadline = forever ? Clock::time_point::max() : Clock::now() + timeout;
+
+        for (;;) {
+            // Read the counter first: a write after this read changes it.
+            auto seen = change_seq_.load(std::memory_order_acquire);
+            if (pred(*storage_.current())) return true;
+            if (!forever && Clock::now() >= deadline) return false;
+
+            if (strategy != WaitStrategy::Park && spinUntilChanged(seen, deadline, strategy == WaitStrategy::Spin)) continue;
+            if (strategy == WaitStrategy::Spin) continue;  // Deadline reached; re-check once
+
+            parked_.fetch_add(1, std::memory_order_seq_cst);
+            if (change_seq_.load(std::memory_order_seq_cst) == seen) {
+                auto remaining = forever ? std::chrono::nanoseconds(-1)
+                                         : std::max(std::chrono::nanoseconds(0), std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - Clock::now()));
+                detail::parkWord(change_seq_, seen, remaining);
             }
+            parked_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
 
-            snapshot = listeners_;
-            snapshotValue = value_;
+    // Awaitable for the next committed value: `T v = co_await atom->changed();`.
+    // The waiter lives in the coroutine frame, so awaiting allocates nothing. The
+    // coroutine resumes on executor, or on the writing thread when none is given,
+    // and must not be destroyed while suspended here.
+    class Changed : private detail::ChangeWaiter<Version> {
+    public:
+        Changed(std::shared_ptr<Atom> atom, std::shared_ptr<Executor> executor)
+            : atom_(std::move(atom)), executor_(std::move(executor)) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> handle) {
+            handle_ = handle;
+            atom_->pushWaiter(this);  // May resume at once on another thread
+        }
+
+        T await_resume() { return *version_; }
+
+    private:
+        void wake(const Version& version) override {
+            version_ = version;
+            detail::resumeOn(executor_, handle_);
         }
-        notify(snapshot, snapshotValue);
+
+        std::shared_ptr<Atom> atom_;
+        std::shared_ptr<Executor> executor_;
+        std::coroutine_handle<> handle_;
+        Version version_{};
+    };
+
+    Changed changed(std::shared_ptr<Executor> executor = nullptr) {
+        return Changed(this->shared_from_this(), std::move(executor));
     }
 
-    void update(std::function<T(const T&)> updater) {
-        ListenerMap snapshot;
-        T snapshotValue;
-        {
-            std::unique_lock lock(mutex_);
-            auto newValue = updater(value_);
-            if constexpr (std::equality_comparable<T>) {
-                if (newValue == value_) return;
+    // Asynchronous stream of the latest committed value: `while (auto v =
+    // co_await stream.next()) { ... }`. Subscribes once; each element is handed
+    // over through a single slot, so elements cost no allocation. Values
+    // committed while the consumer is not awaiting are conflated to the latest;
+    // use subscribeQueued() to see every value. Only one coroutine may await
+    // next() at a time.
+    class ConflatedStream {
+        struct State {
+            std::mutex mutex;
+            Version pending{};
+            bool closed{false};
+            std::coroutine_handle<> waiting;
+            std::shared_ptr<Executor> executor;
+        };
+
+    public:
+        class Next {
+        public:
+            explicit Next(State& state) : state_(state) {}
+
+            bool await_ready() const noexcept { return false; }
+
+            // Does not suspend when a value is pending or the stream is closed.
+            bool await_suspend(std::coroutine_handle<> handle) {
+                std::unique_lock lock(state_.mutex);
+                if (state_.pending || state_.closed) return false;
+                state_.waiting = handle;
+                return true;
             }
 
-            if constexpr (std::is_move_assignable_v<T>) {
-                value_ = std::move(newValue);
-            } else {
-                value_ = newValue;
+            // Empty once the stream is closed and no value is left pending.
+            std::optional<T> await_resume() {
+                std::unique_lock lock(state_.mutex);
+                Version version = std::move(state_.pending);
+                state_.pending = Version{};
+                lock.unlock();
+                if (!version) return std::nullopt;
+                return *version;
             }
 
-            snapshot = listeners_;
-            snapshotValue = value_;
+        private:
+            State& state_;
+        };
+
+        ConflatedStream(std::shared_ptr<State> state, Subscription<T, Equal> subscription)
+            : state_(std::move(state)), subscription_(std::move(subscription)) {}
+
+        Next next() { return Next(*state_); }
+
+        // Stops new values and ends the stream: a coroutine suspended in next()
+        // resumes with an empty result, as does every later next() once a value
+        // already pending has been taken. Destroying the stream does not resume
+        // a waiter, so close it first.
+        void close() {
+            subscription_.unsubscribe();
+            std::unique_lock lock(state_->mutex);
+            state_->closed = true;
+            auto handle = std::exchange(state_->waiting, nullptr);
+            lock.unlock();
+            if (handle) detail::resumeOn(state_->executor, handle);
+        }
+
+    private:
+        friend class Atom;
+
+        static void put(State& state, const Version& version) {
+            std::unique_lock lock(state.mutex);
+            state.pending = version;
+            auto handle = std::exchange(state.waiting, nullptr);
+            lock.unlock();
+            if (handle) detail::resumeOn(state.executor, handle);
         }
-        notify(snapshot, snapshotValue);
+
+        std::shared_ptr<State> state_;
+        Subscription<T, Equal> subscription_;
+    };
+
+    ConflatedStream conflatedChanges(std::shared_ptr<Executor> executor = nullptr) {
+        auto state = std::make_shared<typename ConflatedStream::State>();
+        state->executor = std::move(executor);
+        auto subscription = addListener({0, nullptr, nullptr, std::make_shared<const VersionCallback>([state](const Version& version) {
+            ConflatedStream::put(*state, version);
+            return true;
+        })});
+        return ConflatedStream(std::move(state), std::move(subscription));
     }
 
-    Subscription<T> subscribe(std::function<void(const T&)> callback) {
+    // Parallel fan-out for atoms with very many listeners. A notification wave
+    // reaching at least `threshold` listeners is cut into chunks of `chunk`
+    // listeners that run on pool, with the writer helping; the write returns once
+    // every chunk is delivered. Listeners in different chunks run concurrently and
+    // in no particular order, and each exception still goes to onError. Smaller
+    // waves stay serial on the writer thread, as do all waves after
+    // parallelNotify(nullptr).
+    void parallelNotify(std::shared_ptr<WorkStealingPool> pool, size_t threshold = 1024, size_t chunk = 256) {
         std::unique_lock lock(mutex_);
-        auto id = next_id_++;
-        listeners_[id] = std::move(callback);
-        return Subscription<T>(this->shared_from_this(), id);
+        if (!pool) {
+            fan_out_threshold_.store(SIZE_MAX, std::memory_order_relaxed);
+            fan_out_.store(nullptr);
+            return;
+        }
+        threshold = std::max<size_t>(threshold, 1);
+        fan_out_.store(std::make_shared<const FanOut>(FanOut{std::move(pool), threshold, std::max<size_t>(chunk, 1)}));
+        fan_out_threshold_.store(threshold, std::memory_order_relaxed);
     }
 
     Atom(const Atom&) = delete;
@@ -138,28 +1371,580 @@ public:
     Atom& operator=(Atom&&) = delete;
 
 private:
-    friend class Subscription<T>;
+    friend class Subscription<T, Equal>;
+    friend class Transaction;
+
+    uint64_t trackedVersion() const override { return version(); }
+
+    std::shared_ptr<void> onChange(InplaceFunction<void(), 32> callback) const override {
+        // Atoms are only ever owned through a non-const shared_ptr.
+        auto subscription = const_cast<Atom*>(this)->subscribe([callback = std::move(callback)](const T&) { callback(); });
+        return std::make_shared<Subscription<T, Equal>>(std::move(subscription));
+    }
+
+    std::shared_ptr<const detail::TrackedAtom> trackedSelf() const override { return this->shared_from_this(); }
+
+    // Notification owed by a Batch: the version the atom had before the batch
+    // first wrote it, and the latest version the batch committed.
+    struct PendingNotify : detail::PendingFlush {
+        PendingNotify(std::shared_ptr<Atom> atom, Version baseline, Version latest)
+            : atom(std::move(atom)), baseline(std::move(baseline)), latest(std::move(latest)) {}
+
+        void flush() override {
+            if (detail::sameValue<Equal>(*latest, *baseline)) return;
+            // Batch scopes end in a destructor, so overflow is reported, not thrown.
+            if (auto overflow = atom->notify(latest); overflow && atom->on_error_) atom->on_error_(overflow);
+        }
+
+        std::shared_ptr<Atom> atom;
+        Version baseline;
+        Version latest;
+    };
+
+    // Runs one storage write and delivers its notification, or defers it to the
+    // end of the outermost Batch active on this thread.
+    template <typename Write>
+    void commit(Write&& write) {
+        auto& batch = detail::batchState();
+        if (batch.depth == 0) {
+            auto committed = write();
+            if (!committed) return;
+            version_.fetch_add(1, std::memory_order_release);
+            if (auto overflow = notify(committed)) std::rethrow_exception(overflow);
+            return;
+        }
+
+        auto* pending = static_cast<PendingNotify*>(batch.find(this));
+        Version baseline = pending ? Version{} : storage_.current();
+        auto committed = write();
+        if (!committed) return;
+        version_.fetch_add(1, std::memory_order_release);
+        if (pending) {
+            pending->latest = std::move(committed);
+        } else {
+            batch.add(this, std::make_unique<PendingNotify>(this->shared_from_this(), std::move(baseline), std::move(committed)));
+        }
+    }
+
+    struct CombineRequest {
+        std::function<T(const T&)>* updater{nullptr};
+        CombineRequest* next{nullptr};
+        std::exception_ptr error{};
+        std::atomic<bool> done{false};
+    };
+
+    // Called with combine_mutex_ held. Drains the publication list and applies it
+    // as a single storage write.
+    Version combine() {
+        auto* head = combine_head_.exchange(nullptr, std::memory_order_acquire);
+        if (!head) return {};
 
-    void notify(const ListenerMap& snapshot, const T& value) {
-        for (const auto& [id, cb] : snapshot) {
+        Version committed;
+        std::exception_ptr failure;
+        try {
+            std::vector<CombineRequest*> batch;
+            for (auto* r = head; r; r = r->next) batch.push_back(r);
+            std::reverse(batch.begin(), batch.end());
+
+            committed = storage_.modify([&](const T& current) {
+                std::optional<T> value(current);
+                for (auto* r : batch) {
+                    r->error = nullptr;
+                    try {
+                        value.emplace((*r->updater)(*value));
+                    } catch (...) {
+                        r->error = std::current_exception();
+                    }
+                }
+                return std::move(*value);
+            });
+        } catch (...) {
+            // Nothing was published: every drained request fails with the cause.
+            failure = std::current_exception();
+        }
+
+        for (auto* r = head; r;) {
+            auto* next = r->next;  // r may be gone once done is set
+            if (failure) r->error = failure;
+            r->done.store(true, std::memory_order_release);
+            r = next;
+        }
+        return committed;
+    }
+
+    // Listeners delivered through an executor, see subscribe(callback, executor).
+    // `slot` is the group's own entry in the dense listener array.
+    struct ExecutorGroup {
+        uint32_t slot;
+        std::shared_ptr<detail::Strand<Version>> strand;
+        std::shared_ptr<detail::AtomicSharedPtr<const ListenerList>> listeners;
+    };
+
+    static std::shared_ptr<const ListenerList> withListener(const ListenerList& current, Listener listener) {
+        auto next = std::make_shared<ListenerList>();
+        next->reserve(current.size() + 1);
+        next->insert(next->end(), current.begin(), current.end());
+        next->push_back(std::move(listener));
+        return next;
+    }
+
+    // Null when slot is not in the list.
+    static std::shared_ptr<const ListenerList> withoutListener(const ListenerList& current, uint32_t slot) {
+        auto it = std::find_if(current.begin(), current.end(), [&](const Listener& l) { return l.slot == slot; });
+        if (it == current.end()) return nullptr;
+        auto next = std::make_shared<ListenerList>();
+        next->reserve(current.size() - 1);
+        next->insert(next->end(), current.begin(), it);
+        next->insert(next->end(), std::next(it), current.end());
+        return next;
+    }
+
+    // Slot map entry. A slot either indexes the dense array, belongs to an
+    // executor group (whose own slot it records), or is free.
+    struct Slot {
+        static constexpr uint32_t kNone = UINT32_MAX;
+        uint32_t generation{0};
+        uint32_t dense{kNone};
+        uint32_t group{kNone};
+    };
+
+    // The following helpers are called with mutex_ held.
+    detail::ListenerHandle allocateSlot() {
+        uint32_t slot;
+        if (!free_slots_.empty()) {
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+        } else {
+            slot = static_cast<uint32_t>(slots_.size());
+            slots_.emplace_back();
+        }
+        return {slot, slots_[slot].generation};
+    }
+
+    void releaseSlot(uint32_t slot) {
+        slots_[slot] = Slot{slots_[slot].generation + 1};
+        free_slots_.push_back(slot);
+    }
+
+    detail::ListenerHandle insertDense(Listener listener) {
+        auto handle = allocateSlot();
+        listener.slot = handle.slot;
+        slots_[handle.slot].dense = static_cast<uint32_t>(dense_.size());
+        dense_.push_back(std::move(listener));
+        listener_count_.store(dense_.size(), std::memory_order_relaxed);
+        publishListeners({dense_.size() - 1});
+        return handle;
+    }
+
+    // Swap-remove: the last listener takes the freed position.
+    void eraseDense(uint32_t slot) {
+        auto index = slots_[slot].dense;
+        if (index != dense_.size() - 1) {
+            dense_[index] = std::move(dense_.back());
+            slots_[dense_[index].slot].dense = index;
+        }
+        dense_.pop_back();
+        releaseSlot(slot);
+        listener_count_.store(dense_.size(), std::memory_order_relaxed);
+        publishListeners({index, dense_.size()});  // The hole and the shortened tail
+    }
+
+    Subscription<T, Equal> addListener(Listener listener) {
+        std::unique_lock lock(mutex_);
+        return Subscription<T, Equal>(this->shared_from_this(), insertDense(std::move(listener)));
+    }
+
+    void removeListener(detail::ListenerHandle handle) {
+        std::unique_lock lock(mutex_);
+        if (handle.slot >= slots_.size() || slots_[handle.slot].generation != handle.generation) return;
+        auto& slot = slots_[handle.slot];
+        if (slot.dense != Slot::kNone) {
+            eraseDense(handle.slot);
+            return;
+        }
+        if (slot.group == Slot::kNone) return;
+
+        auto group = std::find_if(groups_.begin(), groups_.end(), [&](const ExecutorGroup& g) { return g.slot == slot.group; });
+        auto next = withoutListener(*group->listeners->load(), handle.slot);
+        releaseSlot(handle.slot);
+        if (next->empty()) {
+            // Last listener gone: stop enqueueing for this group.
+            eraseDense(group->slot);
+            groups_.erase(group);
+        } else {
+            group->listeners->store(std::move(next));
+        }
+    }
+
+    // Called with mutex_ held after dense_ changed at the given positions.
+    // Rebuilds the chunks holding them and publishes, so subscribing and
+    // unsubscribing pay for publication and notify() never allocates.
+    void publishListeners(std::initializer_list<size_t> changed) {
+        constexpr size_t kChunk = PublishedListeners::kChunk;
+        constexpr size_t kPage = PublishedListeners::kPage;
+        auto count = (dense_.size() + kChunk - 1) / kChunk;
+        chunks_.resize(count);
+        pages_.resize((count + kPage - 1) / kPage);
+        for (auto index : changed) {
+            auto chunk = index / kChunk;
+            if (chunk >= count) continue;  // Dropped with the shortened tail
+            auto begin = dense_.begin() + static_cast<ptrdiff_t>(chunk * kChunk);
+            auto end = dense_.begin() + static_cast<ptrdiff_t>(std::min(dense_.size(), (chunk + 1) * kChunk));
+            chunks_[chunk] = std::make_shared<const ListenerList>(begin, end);
+        }
+        // Pages after the chunks: a page may also have lost a dropped tail chunk.
+        for (auto index : changed) {
+            auto page = index / kChunk / kPage;
+            if (page >= pages_.size()) continue;
+            auto begin = chunks_.begin() + static_cast<ptrdiff_t>(page * kPage);
+            auto end = chunks_.begin() + static_cast<ptrdiff_t>(std::min(count, (page + 1) * kPage));
+            pages_[page] = std::make_shared<const typename PublishedListeners::Page>(begin, end);
+        }
+        listeners_.store(std::make_shared<const PublishedListeners>(PublishedListeners{pages_, dense_.size()}));
+    }
+
+    // Set by parallelNotify(). A notify() still using a replaced one keeps it,
+    // and its pool, alive until the wave is delivered.
+    struct FanOut {
+        std::shared_ptr<WorkStealingPool> pool;
+        size_t threshold;
+        size_t chunk;
+    };
+
+    // Returns the first QueueOverflow raised by one of this atom's queued
+    // subscriptions, for the
+    // writer to rethrow once every listener and waiter has been notified.
+    std::exception_ptr notify(const Version& committed) {
+        change_seq_.fetch_add(1, std::memory_order_seq_cst);
+        // Pairs with the parked_ increment in waitUntil(), so either the waiter
+        // sees the new counter or this sees the waiter.
+        if (parked_.load(std::memory_order_seq_cst)) detail::wakeWord(change_seq_);
+        auto overflow = notifyListeners(committed);
+        if (waiters_.load(std::memory_order_acquire)) wakeWaiters(committed);
+        return overflow;
+    }
+
+    // Polls the change counter. Returns true once it moves away from seen; false
+    // when the spin budget (unless `untilDeadline`) or the deadline runs out.
+    bool spinUntilChanged(uint32_t seen, std::chrono::steady_clock::time_point deadline, bool untilDeadline) const {
+        constexpr uint32_t kSpinBudget = 4096;
+        constexpr uint32_t kClockStride = 256;
+        for (uint32_t i = 1;; i++) {
+            if (change_seq_.load(std::memory_order_acquire) != seen) return true;
+            if (!untilDeadline && i >= kSpinBudget) return false;
+            if (i % kClockStride == 0 && std::chrono::steady_clock::now() >= deadline) return false;
+            detail::cpuRelax();
+        }
+    }
+
+    void pushWaiter(detail::ChangeWaiter<Version>* waiter) {
+        auto* head = waiters_.load(std::memory_order_relaxed);
+        do {
+            waiter->next = head;
+        } while (!waiters_.compare_exchange_weak(head, waiter, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Takes every registered waiter; a waiter registering during the wake waits
+    // for the following write.
+    void wakeWaiters(const Version& committed) {
+        auto* waiter = waiters_.exchange(nullptr, std::memory_order_acquire);
+        while (waiter) {
+            auto* next = waiter->next;  // The waiter is gone once woken
             try {
-                cb(value);
+                waiter->wake(committed);
             } catch (...) {
-                if (on_error_) {
-                    on_error_(std::current_exception());
+                if (on_error_) on_error_(std::current_exception());
+            }
+            waiter = next;
+        }
+    }
+
+    std::exception_ptr notifyListeners(const Version& committed) {
+        // No subscribers: skip the shared pointer load and its refcount traffic.
+        if (listener_count_.load(std::memory_order_relaxed) == 0) return nullptr;
+        auto listeners = listeners_.load();
+        auto size = listeners->size;
+        if (size == 0) return nullptr;
+        // The threshold alone keeps small waves off the shared pointer load.
+        std::shared_ptr<const FanOut> fanOut;
+        if (size >= fan_out_threshold_.load(std::memory_order_relaxed)) fanOut = fan_out_.load();
+        if (!fanOut || size < fanOut->threshold) {
+            std::shared_ptr<const T> shared;
+            return deliver(*listeners, 0, size, committed, shared, on_error_);
+        }
+        // Share once up front: chunks must not race to create it.
+        auto shared = detail::shareVersion(committed);
+        std::mutex overflowMutex;
+        std::exception_ptr overflow;
+        fanOut->pool->parallelFor(size, fanOut->chunk, [&](size_t begin, size_t end) {
+            if (auto chunkOverflow = deliver(*listeners, begin, end, committed, shared, on_error_)) {
+                std::unique_lock lock(overflowMutex);
+                if (!overflow) overflow = chunkOverflow;
+            }
+        });
+        return overflow;
+    }
+
+    // Delivers one value to an executor group. Group listeners are plain
+    // callbacks, so no overflow is reported and every exception goes to onError.
+    static void deliver(const ListenerList& listeners, const Version& committed, const std::function<void(std::exception_ptr)>& onError) {
+        std::shared_ptr<const T> shared;
+        deliver(listeners, 0, listeners.size(), committed, shared, onError);
+    }
+
+    // Delivers to published listeners [begin, end), chunk by chunk.
+    static std::exception_ptr deliver(const PublishedListeners& listeners, size_t begin, size_t end, const Version& committed,
+                                      std::shared_ptr<const T>& shared, const std::function<void(std::exception_ptr)>& onError) {
+        constexpr size_t kChunk = PublishedListeners::kChunk;
+        std::exception_ptr overflow;
+        while (begin < end) {
+            const auto& chunk = listeners.chunk(begin / kChunk);
+            auto offset = begin % kChunk;
+            auto stop = std::min(chunk.size(), offset + (end - begin));
+            auto chunkOverflow = deliver(chunk, offset, stop, committed, shared, onError);
+            if (!overflow) overflow = chunkOverflow;
+            begin += stop - offset;
+        }
+        return overflow;
+    }
+
+    // Delivers to listeners [begin, end). `shared` is filled in on first use.
+    static std::exception_ptr deliver(const ListenerList& listeners, size_t begin, size_t end, const Version& committed,
+                                      std::shared_ptr<const T>& shared, const std::function<void(std::exception_ptr)>& onError) {
+        std::exception_ptr overflow;
+        for (size_t i = begin; i < end; i++) {
+            const auto& listener = listeners[i];
+            try {
+                if (listener.callback) {
+                    (*listener.callback)(*committed);
+                } else if (listener.ref) {
+                    listener.ref(*committed);
+                } else if (listener.versionCallback) {
+                    if (!(*listener.versionCallback)(committed) && !overflow) overflow = std::make_exception_ptr(QueueOverflow());
+                } else {
+                    if (!shared) shared = detail::shareVersion(committed);
+                    (*listener.snapshotCallback)(shared);
+                }
+            } catch (...) {
+                if (onError) {
+                    onError(std::current_exception());
                 }
             }
         }
+        return overflow;
     }
 
-    mutable std::shared_mutex mutex_;
-    T value_;
-    ListenerMap listeners_;
-    uint64_t next_id_{0};
+    // Guards the slot map, the dense listener array and groups_, and serialises
+    // publication. Value reads and writes go through storage_.
+    std::mutex mutex_;
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> free_slots_;
+    ListenerList dense_;
+    // Every current chunk and page, see publishListeners(); only pages_ is copied
+    // into the published listeners.
+    std::vector<std::shared_ptr<const ListenerList>> chunks_;
+    std::vector<std::shared_ptr<const typename PublishedListeners::Page>> pages_;
+    std::vector<ExecutorGroup> groups_;
+    detail::StorageFor<T, Equal> storage_;
+    detail::AtomicSharedPtr<const PublishedListeners> listeners_{std::make_shared<const PublishedListeners>()};
+    std::atomic<size_t> listener_count_{0};
+    std::atomic<uint64_t> version_{0};
+    detail::OptimisticCounters optimistic_;
+    detail::TxStamp stamp_{0};
+    std::atomic<CombineRequest*> combine_head_{nullptr};
+    std::atomic<detail::ChangeWaiter<Version>*> waiters_{nullptr};
+    // Bumped by every notification; waitUntil() spins or parks on it.
+    std::atomic<uint32_t> change_seq_{0};
+    std::atomic<uint32_t> parked_{0};
+    std::mutex combine_mutex_;
     std::function<void(std::exception_ptr)> on_error_;
+    detail::AtomicSharedPtr<const FanOut> fan_out_{nullptr};
+    std::atomic<size_t> fan_out_threshold_{SIZE_MAX};  // Of fan_out_, SIZE_MAX when unset
 };
 
-template <typename T>
-std::shared_ptr<Atom<T>> createAtom(T initial, std::function<void(std::exception_ptr)> onError) {
-    return std::make_shared<Atom<T>>(typename Atom<T>::PrivateKey{}, std::move(initial), std::move(onError));
+// Defers notifications for writes made on this thread until the outermost Batch
+// ends. Writes are still visible to readers immediately. Each atom written in the
+// batch then notifies once with its final value, and not at all if it ended up
+// equal to its value before the batch.
+class Batch {
+public:
+    Batch() { detail::batchState().depth++; }
+
+    ~Batch() {
+        auto& state = detail::batchState();
+        if (--state.depth > 0) return;
+        // Listeners may write again, so flush from a detached list.
+        auto pending = std::move(state.pending);
+        state.pending.clear();
+        state.byAtom.clear();
+        for (auto& entry : pending) entry->flush();
+    }
+
+    Batch(const Batch&) = delete;
+    Batch& operator=(const Batch&) = delete;
+};
+
+template <typename F>
+void batch(F&& body) {
+    Batch scope;
+    body();
+}
+
+// Software transaction over several atoms, in the style of TL2: reads are
+// validated against a global version clock as they happen, writes are buffered,
+// and commit locks the written atoms' stamps, revalidates the read set and
+// installs every write before any stamp is released. Conflicts abort and retry
+// the whole body, so it must be free of side effects other than tx reads and
+// writes. Listeners run once after commit, as if the writes were in a Batch.
+//
+// Isolation is between transactions: plain set()/update() calls on an atom are
+// not ordered against a transaction committing to the same atom.
+class Transaction {
+public:
+    template <typename T, typename Equal>
+    T read(const std::shared_ptr<Atom<T, Equal>>& atom) {
+        if (auto* w = findWrite(&atom->stamp_)) return *static_cast<Write<T, Equal>*>(w)->value;
+
+        auto before = atom->stamp_.load(std::memory_order_acquire);
+        T value = atom->storage_.load();
+        auto after = atom->stamp_.load(std::memory_order_acquire);
+        if (before != after || (before & 1) || (before >> 1) > read_version_) throw detail::TxConflict{};
+        reads_.push_back(&atom->stamp_);
+        return value;
+    }
+
+    template <typename T, typename Equal>
+    void write(const std::shared_ptr<Atom<T, Equal>>& atom, std::type_identity_t<T> value) {
+        if (auto* w = findWrite(&atom->stamp_)) {
+            static_cast<Write<T, Equal>*>(w)->value.emplace(std::move(value));
+            return;
+        }
+        writes_.push_back(std::make_unique<Write<T, Equal>>(atom, std::move(value)));
+    }
+
+    Transaction(const Transaction&) = delete;
+    Transaction& operator=(const Transaction&) = delete;
+
+private:
+    template <typename F>
+    friend decltype(auto) atomically(F&& body);
+
+    struct WriteBase {
+        explicit WriteBase(detail::TxStamp* stamp) : stamp(stamp) {}
+        virtual ~WriteBase() = default;
+        virtual void apply() = 0;
+
+        detail::TxStamp* stamp;
+        uint64_t unlocked{0};  // Stamp value before commit locked it
+    };
+
+    template <typename T, typename Equal>
+    struct Write : WriteBase {
+        Write(std::shared_ptr<Atom<T, Equal>> atom, T value)
+            : WriteBase(&atom->stamp_), atom(std::move(atom)), value(std::move(value)) {}
+
+        void apply() override {
+            atom->commit([&] { return atom->storage_.replace(std::move(*value)); });
+        }
+
+        std::shared_ptr<Atom<T, Equal>> atom;
+        std::optional<T> value;
+    };
+
+    Transaction() : read_version_(detail::txClock().load(std::memory_order_acquire)) {}
+
+    WriteBase* findWrite(const detail::TxStamp* stamp) const {
+        for (const auto& w : writes_) {
+            if (w->stamp == stamp) return w.get();
+        }
+        return nullptr;
+    }
+
+    void unlock(size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            writes_[i]->stamp->store(writes_[i]->unlocked, std::memory_order_release);
+        }
+    }
+
+    bool validate() const {
+        for (const auto* stamp : reads_) {
+            auto value = stamp->load(std::memory_order_acquire);
+            if (value & 1) {
+                auto* w = findWrite(stamp);
+                if (!w) return false;
+                value = w->unlocked;
+            }
+            if ((value >> 1) > read_version_) return false;
+        }
+        return true;
+    }
+
+    bool commit() {
+        if (writes_.empty()) return true;  // Every read was already validated
+
+        // Lock in address order so concurrent commits cannot deadlock.
+        std::sort(writes_.begin(), writes_.end(), [](const auto& a, const auto& b) { return a->stamp < b->stamp; });
+        for (size_t i = 0; i < writes_.size(); i++) {
+            auto& w = *writes_[i];
+            auto value = w.stamp->load(std::memory_order_relaxed);
+            if ((value & 1) || !w.stamp->compare_exchange_strong(value, value | 1, std::memory_order_acquire)) {
+                unlock(i);
+                return false;
+            }
+            w.unlocked = value;
+        }
+
+        auto write_version = detail::txClock().fetch_add(1, std::memory_order_acq_rel) + 1;
+        if (write_version != read_version_ + 1 && !validate()) {
+            unlock(writes_.size());
+            return false;
+        }
+
+        Batch scope;
+        size_t applied = 0;
+        try {
+            for (; applied < writes_.size(); applied++) writes_[applied]->apply();
+        } catch (...) {
+            // Writes already installed stay visible, so they must carry the new
+            // stamp for readers to detect them; the throwing one may have been
+            // installed too. Only the writes never attempted keep their old stamp.
+            for (size_t i = 0; i <= applied; i++) writes_[i]->stamp->store(write_version << 1, std::memory_order_release);
+            for (size_t i = applied + 1; i < writes_.size(); i++) writes_[i]->stamp->store(writes_[i]->unlocked, std::memory_order_release);
+            throw;
+        }
+        for (auto& w : writes_) w->stamp->store(write_version << 1, std::memory_order_release);
+        return true;
+    }
+
+    uint64_t read_version_;
+    std::vector<const detail::TxStamp*> reads_;
+    std::vector<std::unique_ptr<WriteBase>> writes_;
+};
+
+// Runs body(Transaction&) until it commits and returns its result. If installing
+// a write throws (allocation, or an Equal that throws), the exception propagates
+// and writes already installed are not rolled back; they carry the commit's
+// stamp, so concurrent transactions that read them conflict and retry.
+template <typename F>
+decltype(auto) atomically(F&& body) {
+    detail::Backoff backoff;
+    for (;;) {
+        Transaction tx;
+        try {
+            if constexpr (std::is_void_v<std::invoke_result_t<F&, Transaction&>>) {
+                body(tx);
+                if (tx.commit()) return;
+            } else {
+                auto result = body(tx);
+                if (tx.commit()) return result;
+            }
+        } catch (const detail::TxConflict&) {
+        }
+        backoff.pause();
+    }
+}
+
+template <typename T, typename Equal = DefaultEquality>
+std::shared_ptr<Atom<T, Equal>> createAtom(T initial, std::function<void(std::exception_ptr)> onError) {
+    return std::make_shared<Atom<T, Equal>>(typename Atom<T, Equal>::PrivateKey{}, std::move(initial), std::move(onError));
 }
\ No newline at end of file
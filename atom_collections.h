@@ -0,0 +1,220 @@
+//
+// Created by Alex Edgar on 13/02/2026.
+//
+
+#pragma once
+
+#include "atom.h"
+
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+
+// Collection atoms that describe each change as a compact delta, so subscribers
+// can maintain a replica in O(changes) instead of re-diffing the whole container.
+
+enum class DeltaOp {
+    Insert,  // New element at key (index for vectors, shifting later ones up)
+    Erase,   // Element at key removed (shifting later vector elements down)
+    Assign,  // Existing element at key replaced
+};
+
+template <typename Key, typename Value>
+struct DeltaEntry {
+    DeltaOp op;
+    Key key;
+    std::optional<Value> value;  // Empty for Erase
+};
+
+// What a delta subscriber receives. When reset is set, the ops do not lead from
+// the subscriber's last delivery to items, because deliveries were coalesced (in
+// a Batch) or raced; the subscriber should resynchronise from items.
+template <typename Container, typename Key, typename Value>
+struct Delta {
+    std::shared_ptr<const Container> items;
+    bool reset;
+    std::shared_ptr<const std::vector<DeltaEntry<Key, Value>>> ops;  // Shared with the version, like items
+};
+
+namespace detail {
+
+// Shared machinery: an Atom over {items, version, ops since previous version}.
+// Every committed edit bumps the version, so a subscriber that sees a gap knows
+// it missed ops.
+template <typename Container, typename Key, typename Value>
+class DeltaAtom {
+protected:
+    using Entry = DeltaEntry<Key, Value>;
+    using Ops = std::vector<Entry>;
+
+    struct State {
+        std::shared_ptr<const Container> items;
+        uint64_t version;
+        std::shared_ptr<const Ops> ops;
+    };
+
+public:
+    using DeltaType = Delta<Container, Key, Value>;
+    using Handle = Subscription<State, IdentityEquality>;
+
+    Container get() const { return *atom_->snapshot()->items; }
+    std::shared_ptr<const Container> snapshot() const { return atom_->snapshot()->items; }
+    size_t size() const { return atom_->snapshot()->items->size(); }
+
+    Handle subscribe(std::function<void(const Container&)> callback) {
+        return atom_->subscribe([callback = std::move(callback)](const State& state) { callback(*state.items); });
+    }
+
+    Handle subscribeDelta(std::function<void(const DeltaType&)> callback) {
+        struct Cursor {
+            std::mutex mutex;
+            uint64_t version;
+        };
+        // Read the version before registering: a write in between shows up as a gap.
+        auto cursor = std::make_shared<Cursor>();
+        cursor->version = atom_->snapshot()->version;
+
+        return atom_->subscribe([cursor, callback = std::move(callback)](const State& state) {
+            std::unique_lock lock(cursor->mutex);
+            if (state.version <= cursor->version) return;  // Stale, a newer one was delivered
+            bool reset = state.version != cursor->version + 1;
+            cursor->version = state.version;
+            lock.unlock();  // The callback may write to this collection
+            callback(DeltaType{state.items, reset, state.ops});
+        });
+    }
+
+protected:
+    DeltaAtom(Container initial, std::function<void(std::exception_ptr)> onError)
+        : atom_(createAtom<State, IdentityEquality>(
+              State{std::make_shared<const Container>(std::move(initial)), 0, std::make_shared<const Ops>()},
+              std::move(onError))) {}
+
+    // Applies ops to a private copy of the items and commits them as one version
+    // with one notification. Ops that change nothing are dropped by apply(),
+    // which returns whether the op took effect; if it throws, nothing is committed.
+    // An Insert or Assign without a value throws std::invalid_argument.
+    template <typename Apply>
+    void commit(Ops ops, Apply&& apply) {
+        atom_->mutate([&](State& state) {
+            auto items = std::make_shared<Container>(*state.items);
+            Ops applied;
+            for (auto& op : ops) {
+                if (op.op != DeltaOp::Erase && !op.value) throw std::invalid_argument("delta op without a value");
+                if (apply(*items, op)) applied.push_back(std::move(op));
+            }
+            if (applied.empty()) return false;
+            state.items = std::move(items);
+            state.version++;
+            state.ops = std::make_shared<const Ops>(std::move(applied));
+            return true;
+        });
+    }
+
+    std::shared_ptr<Atom<State, IdentityEquality>> atom_;
+};
+
+} // namespace detail
+
+template <typename T>
+class AtomVector : public detail::DeltaAtom<std::vector<T>, size_t, T> {
+    using Base = detail::DeltaAtom<std::vector<T>, size_t, T>;
+    using typename Base::Ops;
+
+public:
+    struct PrivateKey {
+    private:
+        PrivateKey() = default;
+        template <typename U>
+        friend std::shared_ptr<AtomVector<U>> createAtomVector(std::vector<U>, std::function<void(std::exception_ptr)> onError);
+    };
+
+    AtomVector(PrivateKey, std::vector<T> initial, std::function<void(std::exception_ptr)> onError)
+        : Base(std::move(initial), std::move(onError)) {}
+
+    // Insert key meaning the end of the vector as of the commit; the delta
+    // records the index it resolved to.
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    void insert(size_t index, T value) { apply({{DeltaOp::Insert, index, std::move(value)}}); }
+    void pushBack(T value) { apply({{DeltaOp::Insert, npos, std::move(value)}}); }
+    void erase(size_t index) { apply({{DeltaOp::Erase, index, std::nullopt}}); }
+    void assign(size_t index, T value) { apply({{DeltaOp::Assign, index, std::move(value)}}); }
+
+    // Applies several ops in order as a single version and notification.
+    // Assignments of an equal value are ignored. An out-of-range index throws
+    // std::out_of_range, and an Insert or Assign without a value throws
+    // std::invalid_argument; either way none of the ops is committed.
+    void apply(Ops ops) {
+        this->commit(std::move(ops), [](std::vector<T>& items, typename Base::Entry& op) {
+            if (op.op == DeltaOp::Insert && op.key == npos) op.key = items.size();
+            auto limit = op.op == DeltaOp::Insert ? items.size() + 1 : items.size();
+            if (op.key >= limit) throw std::out_of_range("AtomVector index out of range");
+            switch (op.op) {
+                case DeltaOp::Insert:
+                    items.insert(items.begin() + op.key, *op.value);
+                    return true;
+                case DeltaOp::Erase:
+                    items.erase(items.begin() + op.key);
+                    return true;
+                case DeltaOp::Assign:
+                    if (detail::sameValue<DefaultEquality>(items[op.key], *op.value)) return false;
+                    items[op.key] = *op.value;
+                    return true;
+            }
+            return false;
+        });
+    }
+};
+
+template <typename K, typename V, typename Map = std::unordered_map<K, V>>
+class AtomMap : public detail::DeltaAtom<Map, K, V> {
+    using Base = detail::DeltaAtom<Map, K, V>;
+    using typename Base::Ops;
+
+public:
+    struct PrivateKey {
+    private:
+        PrivateKey() = default;
+        template <typename K2, typename V2, typename M2>
+        friend std::shared_ptr<AtomMap<K2, V2, M2>> createAtomMap(M2, std::function<void(std::exception_ptr)> onError);
+    };
+
+    AtomMap(PrivateKey, Map initial, std::function<void(std::exception_ptr)> onError)
+        : Base(std::move(initial), std::move(onError)) {}
+
+    // Inserts or assigns. The delta records which of the two happened.
+    void set(K key, V value) { apply({{DeltaOp::Assign, std::move(key), std::move(value)}}); }
+    void erase(K key) { apply({{DeltaOp::Erase, std::move(key), std::nullopt}}); }
+
+    // Applies several ops in order as a single version and notification. Insert
+    // and Assign both upsert; erasing a missing key and assigning an equal value
+    // are ignored. An Insert or Assign without a value throws
+    // std::invalid_argument and commits none of the ops.
+    void apply(Ops ops) {
+        this->commit(std::move(ops), [](Map& items, typename Base::Entry& op) {
+            if (op.op == DeltaOp::Erase) return items.erase(op.key) > 0;
+
+            auto it = items.find(op.key);
+            if (it == items.end()) {
+                items.emplace(op.key, *op.value);
+                op.op = DeltaOp::Insert;
+                return true;
+            }
+            if (detail::sameValue<DefaultEquality>(it->second, *op.value)) return false;
+            it->second = *op.value;
+            op.op = DeltaOp::Assign;
+            return true;
+        });
+    }
+};
+
+template <typename T>
+std::shared_ptr<AtomVector<T>> createAtomVector(std::vector<T> initial, std::function<void(std::exception_ptr)> onError) {
+    return std::make_shared<AtomVector<T>>(typename AtomVector<T>::PrivateKey{}, std::move(initial), std::move(onError));
+}
+
+template <typename K, typename V, typename Map = std::unordered_map<K, V>>
+std::shared_ptr<AtomMap<K, V, Map>> createAtomMap(Map initial, std::function<void(std::exception_ptr)> onError) {
+    return std::make_shared<AtomMap<K, V, Map>>(typename AtomMap<K, V, Map>::PrivateKey{}, std::move(initial), std::move(onError));
+}
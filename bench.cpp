@@ -0,0 +1,81 @@
+//
+// Created by Alex Edgar on 13/02/2026.
+//
+
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <string>
+#include "atom.h"
+
+// Error handler
+auto benchErrorHandler = [](const std::exception_ptr&) {};
+
+// Payloads share a 1 MB prefix and differ only in their last byte, the worst case
+// for operator== since every compare scans the whole string.
+std::vector<std::string> makePayloads(size_t count) {
+    std::vector<std::string> payloads;
+    for (size_t i = 0; i < count; i++) {
+        std::string s(1 << 20, 'x');
+        s.back() = static_cast<char>('a' + i % 26);
+        payloads.push_back(std::move(s));
+    }
+    return payloads;
+}
+
+// A payload that carries its content hash, computed once when it is built, so
+// HashEquality decides inequality with one integer compare.
+struct HashedPayload {
+    std::string text;
+    uint64_t digest;
+
+    uint64_t hash() const { return digest; }
+    bool operator==(const HashedPayload& other) const { return text == other.text; }
+};
+
+std::vector<HashedPayload> hashPayloads(const std::vector<std::string>& payloads) {
+    std::vector<HashedPayload> hashed;
+    for (const auto& p : payloads) hashed.push_back({p, std::hash<std::string>{}(p)});
+    return hashed;
+}
+
+// Average nanoseconds per set() with `threads` writers cycling through payloads.
+template <typename Equal, typename T>
+double timeSets(const std::vector<T>& payloads, int threads, int setsPerThread) {
+    auto atom = createAtom<T, Equal>(payloads[0], benchErrorHandler);
+    auto sub = atom->subscribe([](const T&) {});
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; t++) {
+        writers.emplace_back([&, t]() {
+            for (int i = 0; i < setsPerThread; i++) {
+                atom->set(payloads[(t + i + 1) % payloads.size()]);
+            }
+        });
+    }
+    for (auto& w : writers) w.join();
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+    return elapsed.count() / (threads * setsPerThread);
+}
+
+template <typename Equal, typename T>
+void report(const char* name, const std::vector<T>& payloads) {
+    for (int threads : {1, 4}) {
+        auto ns = timeSets<Equal>(payloads, threads, 200);
+        std::cout << "  " << name << "  writers=" << threads << "  " << ns / 1000.0 << " us/set" << std::endl;
+    }
+}
+
+int main() {
+    std::cout << "\n=== Equality policy: 1 MB payloads ===" << std::endl;
+    auto payloads = makePayloads(8);
+    auto hashed = hashPayloads(payloads);
+    report<DefaultEquality>("DefaultEquality, string         ", payloads);
+    report<HashEquality>("HashEquality, string (rehashed) ", payloads);
+    report<HashEquality>("HashEquality, carried hash      ", hashed);
+    report<IdentityEquality>("IdentityEquality, string        ", payloads);
+    std::cout << "\n=== Done ===" << std::endl;
+    return 0;
+}
@@ -0,0 +1,455 @@
+//
+// Created by Alex Edgar on 13/02/2026.
+//
+
+#pragma once
+
+#include "atom.h"
+
+#include <queue>
+#include <stdexcept>
+#include <unordered_set>
+
+// Derived atoms: a value computed from other atoms (or other derived atoms)
+// that is recomputed only when needed. Each run is memoized on the versions of
+// its inputs: a read compares them with the inputs' current versions and runs
+// the function again only if one moved, so a read always sees committed input
+// values, even inside a Batch. While the derived atom has listeners, an input
+// change also recomputes it straight away. The result goes through the equality
+// skip, so an unchanged result notifies nobody downstream.
+//
+// Inputs are discovered, not declared: every get() or snapshot() of an atom or
+// derived atom made while the function runs is recorded, and the set is
+// collected afresh on each run, so a branch not taken depends on nothing it
+// skipped. Dependencies must not form a cycle: a function that reads its own
+// derived atom, directly or through others, throws std::logic_error.
+//
+// Changes propagate glitch-free. Every derived atom has a height one above its
+// highest input (plain atoms are at height 0). A commit to a plain atom starts a
+// wave that visits the affected derived atoms in height order through a
+// priority queue, so each one runs at most once per commit and only after all
+// of its inputs are up to date. Listeners of derived atoms are notified once
+// the whole wave has settled. Reads outside a wave, from a listener of a plain
+// atom or inside a Batch, pull their inputs' committed versions, so they are
+// consistent with the plain atoms too. Waves started on different threads are
+// each consistent but may interleave.
+
+namespace detail {
+
+class DerivedNode;
+
+// Something derived atoms depend on: keeps the dependents a wave must visit.
+class DependencySource {
+public:
+    virtual ~DependencySource() = default;
+
+    // Up to date version of the value; for a derived atom this recomputes it.
+    virtual uint64_t sourceVersion() = 0;
+    virtual uint32_t height() const = 0;
+
+    void addDependent(const std::shared_ptr<DerivedNode>& node) {
+        std::unique_lock lock(dependents_mutex_);
+        std::erase_if(dependents_, [](const std::weak_ptr<DerivedNode>& d) { return d.expired(); });
+        dependents_.push_back(node);
+    }
+
+    void removeDependent(const DerivedNode* node) {
+        std::unique_lock lock(dependents_mutex_);
+        std::erase_if(dependents_, [&](const std::weak_ptr<DerivedNode>& d) {
+            auto live = d.lock();
+            return !live || live.get() == node;
+        });
+    }
+
+    std::vector<std::shared_ptr<DerivedNode>> dependents() const {
+        std::unique_lock lock(dependents_mutex_);
+        std::vector<std::shared_ptr<DerivedNode>> live;
+        live.reserve(dependents_.size());
+        for (auto& d : dependents_) {
+            if (auto node = d.lock()) live.push_back(std::move(node));
+        }
+        return live;
+    }
+
+private:
+    mutable std::mutex dependents_mutex_;
+    std::vector<std::weak_ptr<DerivedNode>> dependents_;
+};
+
+class DerivedNode : public DependencySource {
+public:
+    uint32_t height() const override { return height_.load(std::memory_order_relaxed); }
+
+    // Visits the node during a wave. Returns whether its dependents need a visit.
+    virtual bool propagate() = 0;
+
+protected:
+    // Keeps every dependent above this node after it gained a deeper input.
+    void raiseHeight(uint32_t height) {
+        if (height <= height_.load(std::memory_order_relaxed)) return;
+        height_.store(height, std::memory_order_relaxed);
+        for (auto& node : dependents()) node->raiseHeight(height + 1);
+    }
+
+    std::atomic<uint32_t> height_{1};
+};
+
+// The derived atoms a single upstream commit affects, lowest height first.
+struct Wave {
+    struct Higher {
+        bool operator()(const std::shared_ptr<DerivedNode>& a, const std::shared_ptr<DerivedNode>& b) const {
+            return a->height() > b->height();
+        }
+    };
+
+    void push(const DependencySource& source) {
+        for (auto& node : source.dependents()) {
+            if (queued.insert(node.get()).second) queue.push(std::move(node));
+        }
+    }
+
+    std::priority_queue<std::shared_ptr<DerivedNode>, std::vector<std::shared_ptr<DerivedNode>>, Higher> queue;
+    std::unordered_set<const DerivedNode*> queued;
+};
+
+inline Wave*& activeWave() {
+    thread_local Wave* wave = nullptr;
+    return wave;
+}
+
+// Runs the wave for a change of source. A write made by a derived function
+// while a wave runs on this thread joins that wave.
+inline void propagateFrom(const DependencySource& source) {
+    if (auto* wave = activeWave()) {
+        wave->push(source);
+        return;
+    }
+
+    struct Scope {
+        explicit Scope(Wave& wave) { activeWave() = &wave; }
+        ~Scope() { activeWave() = nullptr; }
+    };
+
+    Batch batch;  // Outlives the scope: listeners run after the wave, outside it
+    Wave wave;
+    Scope scope(wave);
+    wave.push(source);
+    while (!wave.queue.empty()) {
+        auto node = wave.queue.top();
+        wave.queue.pop();
+        if (node->propagate()) wave.push(*node);
+    }
+}
+
+// One per plain atom that derived atoms read: a single listener on the atom
+// starts one wave for all of its dependents.
+class AtomSource : public DependencySource {
+public:
+    ~AtomSource() override {
+        auto& registry = sourceRegistry();
+        std::unique_lock lock(registry.mutex);
+        auto it = registry.sources.find(atom_.get());
+        if (it != registry.sources.end() && it->second.expired()) registry.sources.erase(it);
+    }
+
+    static std::shared_ptr<AtomSource> of(const TrackedAtom& atom) {
+        auto& registry = sourceRegistry();
+        std::unique_lock lock(registry.mutex);
+        auto& entry = registry.sources[&atom];
+        if (auto existing = entry.lock()) return existing;
+
+        auto source = std::shared_ptr<AtomSource>(new AtomSource(atom.trackedSelf()));
+        entry = source;
+        source->subscription_ = atom.onChange([weak = std::weak_ptr<AtomSource>(source)] {
+            if (auto self = weak.lock()) propagateFrom(*self);
+        });
+        return source;
+    }
+
+    uint64_t sourceVersion() override { return atom_->trackedVersion(); }
+    uint32_t height() const override { return 0; }
+
+private:
+    struct Registry {
+        std::mutex mutex;
+        std::unordered_map<const TrackedAtom*, std::weak_ptr<AtomSource>> sources;
+    };
+
+    static Registry& sourceRegistry() {
+        static Registry registry;
+        return registry;
+    }
+
+    explicit AtomSource(std::shared_ptr<const TrackedAtom> atom) : atom_(std::move(atom)) {}
+
+    std::shared_ptr<const TrackedAtom> atom_;
+    std::shared_ptr<void> subscription_;
+};
+
+// An input seen by one run: the version read, for memoization.
+struct Dependency {
+    const void* key;  // The atom or derived atom read
+    std::shared_ptr<DependencySource> source;
+    uint64_t version;
+};
+
+// Installed while a derived function runs. Records each distinct atom or
+// derived atom read, reusing the previous run's sources where it can.
+class ComputeTracker : public DependencyTracker {
+public:
+    explicit ComputeTracker(const std::vector<Dependency>* previous = nullptr)
+        : previous_(previous), outer_(std::exchange(activeTracker(), this)) {}
+
+    ~ComputeTracker() { activeTracker() = outer_; }
+
+    void track(const TrackedAtom& atom) override {
+        if (seen(&atom)) return;
+        auto version = atom.trackedVersion();
+        auto source = reuse(&atom);
+        deps_.push_back({&atom, source ? std::move(source) : AtomSource::of(atom), version});
+    }
+
+    // version is read by the caller before it reads the value.
+    void track(const void* key, std::shared_ptr<DependencySource> source, uint64_t version) {
+        if (seen(key)) return;
+        deps_.push_back({key, std::move(source), version});
+    }
+
+    std::vector<Dependency> take() { return std::move(deps_); }
+
+    ComputeTracker(const ComputeTracker&) = delete;
+    ComputeTracker& operator=(const ComputeTracker&) = delete;
+
+private:
+    bool seen(const void* key) const {
+        return std::any_of(deps_.begin(), deps_.end(), [&](const Dependency& d) { return d.key == key; });
+    }
+
+    std::shared_ptr<DependencySource> reuse(const void* key) const {
+        if (!previous_) return nullptr;
+        for (auto& d : *previous_) {
+            if (d.key == key) return d.source;
+        }
+        return nullptr;
+    }
+
+    const std::vector<Dependency>* previous_;
+    std::vector<Dependency> deps_;
+    DependencyTracker* outer_;
+};
+
+// The derived atoms whose functions are running on this thread, innermost
+// first. A read of one of them from inside its own run is a cycle: refresh()
+// throws rather than locking the mutex the run already holds.
+struct ComputingScope {
+    explicit ComputingScope(const DerivedNode* node) : node_(node), outer_(std::exchange(innermost(), this)) {}
+    ~ComputingScope() { innermost() = outer_; }
+
+    static bool running(const DerivedNode* node) {
+        for (auto* scope = innermost(); scope; scope = scope->outer_) {
+            if (scope->node_ == node) return true;
+        }
+        return false;
+    }
+
+    ComputingScope(const ComputingScope&) = delete;
+    ComputingScope& operator=(const ComputingScope&) = delete;
+
+private:
+    static ComputingScope*& innermost() {
+        thread_local ComputingScope* scope = nullptr;
+        return scope;
+    }
+
+    const DerivedNode* node_;
+    ComputingScope* outer_;
+};
+
+// Reads made while this is alive are not recorded by an enclosing tracker.
+struct UntrackedScope {
+    UntrackedScope() : outer_(std::exchange(activeTracker(), nullptr)) {}
+    ~UntrackedScope() { activeTracker() = outer_; }
+
+    DependencyTracker* outer_;
+};
+
+} // namespace detail
+
+template <typename Equal = DefaultEquality, typename F>
+auto createComputed(F compute, std::function<void(std::exception_ptr)> onError);
+
+template <typename R, typename Equal = DefaultEquality>
+class Derived : public detail::DerivedNode, public std::enable_shared_from_this<Derived<R, Equal>> {
+public:
+    struct PrivateKey {
+    private:
+        PrivateKey() = default;
+        template <typename E, typename F>
+        friend auto createComputed(F compute, std::function<void(std::exception_ptr)> onError);
+    };
+
+    // onError receives exceptions from listeners, as for any atom, and from the
+    // function when an input change recomputes it for listeners.
+    Derived(PrivateKey, std::function<R()> compute, R initial, std::function<void(std::exception_ptr)> onError)
+        : compute_(std::move(compute)), on_error_(std::move(onError)), output_(createAtom<R, Equal>(std::move(initial), on_error_)),
+          propagated_(output_->version()) {}
+
+    ~Derived() override {
+        for (auto& dep : deps_) dep.source->removeDependent(this);
+    }
+
+    // Recomputes first if an input changed since the last run. Rethrows an
+    // exception from the function, leaving the derived atom dirty.
+    R get() {
+        track();
+        detail::UntrackedScope untracked;
+        refresh();
+        return output_->get();
+    }
+
+    std::shared_ptr<const R> snapshot() {
+        track();
+        detail::UntrackedScope untracked;
+        refresh();
+        return output_->snapshot();
+    }
+
+    uint64_t version() {
+        refresh();
+        return output_->version();
+    }
+
+    // While any listener is registered, input changes recompute eagerly so the
+    // listener hears about them.
+    Subscription<R, Equal> subscribe(typename Atom<R, Equal>::Callback callback) {
+        refresh();
+        return output_->subscribe(std::move(callback));
+    }
+
+    // Times the function has run, including the initial run.
+    uint64_t computations() const { return computations_.load(std::memory_order_relaxed); }
+
+    // Atoms and derived atoms the last run read.
+    size_t dependencyCount() {
+        std::unique_lock lock(mutex_);
+        return deps_.size();
+    }
+
+    Derived(const Derived&) = delete;
+    Derived& operator=(const Derived&) = delete;
+
+private:
+    template <typename E, typename F>
+    friend auto createComputed(F compute, std::function<void(std::exception_ptr)> onError);
+
+    uint64_t sourceVersion() override { return version(); }
+
+    // Records this read with an enclosing derived function, if any.
+    void track() {
+        auto* tracker = detail::activeTracker();
+        if (!tracker) [[likely]] return;
+        // Only derived functions install trackers.
+        static_cast<detail::ComputeTracker*>(tracker)->track(this, this->shared_from_this(), version());
+    }
+
+    // Called with mutex_ held, or before the atom is shared. Registers with
+    // inputs that are new in this run and leaves inputs no longer read.
+    void rewire(std::vector<detail::Dependency> deps) {
+        uint32_t height = 1;
+        for (auto& dep : deps) {
+            bool known = std::any_of(deps_.begin(), deps_.end(), [&](const detail::Dependency& d) { return d.key == dep.key; });
+            if (!known) dep.source->addDependent(this->shared_from_this());
+            height = std::max(height, dep.source->height() + 1);
+        }
+        for (auto& old : deps_) {
+            bool kept = std::any_of(deps.begin(), deps.end(), [&](const detail::Dependency& d) { return d.key == old.key; });
+            if (!kept) old.source->removeDependent(this);
+        }
+        deps_ = std::move(deps);
+        raiseHeight(height);
+    }
+
+    bool propagate() override {
+        // Unobserved: nothing to do now, dependents pull this value when they run.
+        if (output_->listenerCount() == 0) return true;
+        try {
+            refresh();
+        } catch (...) {
+            dirty_.store(true, std::memory_order_release);
+            if (on_error_) on_error_(std::current_exception());
+            return true;  // The next read rethrows too
+        }
+        // Against the last wave, not the value before this call: a read between
+        // the commit and its wave may already have recomputed.
+        auto version = output_->version();
+        return propagated_.exchange(version, std::memory_order_acq_rel) != version;
+    }
+
+    // Recomputes when an input's version moved since the last run. Inputs are
+    // checked on every call rather than trusting the wave to have marked this
+    // atom: a read inside a Batch, or from a listener that runs before the
+    // wave, must still see the committed values.
+    void refresh() {
+        if (detail::ComputingScope::running(this)) [[unlikely]] {
+            throw std::logic_error("derived atoms depend on each other in a cycle");
+        }
+        // Listeners hear the new value after the lock is released: one may read
+        // this atom again while another thread has changed an input.
+        Batch batch;
+        std::unique_lock lock(mutex_);
+        bool unchanged = std::all_of(deps_.begin(), deps_.end(), [](const detail::Dependency& d) {
+            return d.source->sourceVersion() == d.version;
+        });
+        if (unchanged && !dirty_.load(std::memory_order_acquire)) return;
+
+        std::optional<R> value;
+        try {
+            detail::ComputingScope computing(this);
+            detail::ComputeTracker tracker(&deps_);
+            value.emplace(compute_());
+            rewire(tracker.take());
+        } catch (...) {
+            dirty_.store(true, std::memory_order_release);
+            throw;
+        }
+        dirty_.store(false, std::memory_order_release);
+        computations_.fetch_add(1, std::memory_order_relaxed);
+        output_->set(std::move(*value));
+    }
+
+    std::mutex mutex_;  // Serialises runs of the function
+    std::function<R()> compute_;
+    std::function<void(std::exception_ptr)> on_error_;
+    std::shared_ptr<Atom<R, Equal>> output_;
+    std::vector<detail::Dependency> deps_;  // What the current value was computed from
+    std::atomic<bool> dirty_{false};  // The last run threw
+    std::atomic<uint64_t> propagated_{0};  // Output version the last wave passed on
+    std::atomic<uint64_t> computations_{1};
+};
+
+// A derived atom holding compute(), which reads its inputs with get() or
+// snapshot(); the inputs are tracked automatically. Equal is the equality
+// skip applied to each result.
+template <typename Equal, typename F>
+auto createComputed(F compute, std::function<void(std::exception_ptr)> onError) {
+    using R = std::decay_t<std::invoke_result_t<F&>>;
+    std::optional<R> initial;
+    std::vector<detail::Dependency> deps;
+    {
+        detail::ComputeTracker tracker;
+        initial.emplace(compute());
+        deps = tracker.take();
+    }
+    auto derived = std::make_shared<Derived<R, Equal>>(typename Derived<R, Equal>::PrivateKey{}, std::move(compute), std::move(*initial),
+                                                       std::move(onError));
+    derived->rewire(std::move(deps));
+    return derived;
+}
+
+// createDerived(f, onError, a, b) is a derived atom holding f(a->get(), b->get()).
+// Inputs may be Atoms or Derived atoms.
+template <typename Equal = DefaultEquality, typename F, typename... Sources>
+auto createDerived(F compute, std::function<void(std::exception_ptr)> onError, std::shared_ptr<Sources>... sources) {
+    return createComputed<Equal>([compute = std::move(compute), sources...]() mutable { return compute(sources->get()...); },
+                                 std::move(onError));
+}
@@ -0,0 +1,335 @@
+//
+// Created by Alex Edgar on 13/02/2026.
+//
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+
+// Where listener callbacks run. Atom::subscribe(callback, executor) enqueues
+// notifications here instead of invoking the callback on the writing thread.
+class Executor {
+public:
+    virtual ~Executor() = default;
+    virtual void post(std::function<void()> task) = 0;
+};
+
+// Runs each task immediately on the posting thread; today's synchronous behaviour.
+class InlineExecutor : public Executor {
+public:
+    void post(std::function<void()> task) override { task(); }
+};
+
+namespace detail {
+
+// Unbounded intrusive multi-producer single-consumer queue (Vyukov). push() is one
+// exchange plus one store and never blocks; pop() and empty() must only be called
+// by the single consumer.
+template <typename U>
+class MpscQueue {
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        std::optional<U> value;
+    };
+
+public:
+    MpscQueue() : head_(new Node), tail_(head_.load(std::memory_order_relaxed)) {}
+
+    ~MpscQueue() {
+        while (pop()) {}
+        delete tail_;
+    }
+
+    void push(U value) {
+        auto* node = new Node;
+        node->value.emplace(std::move(value));
+        auto* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // Empty while a concurrent push is between its two steps; that producer will
+    // observe its own item afterwards, so callers that re-check state after
+    // publishing never lose it.
+    std::optional<U> pop() {
+        auto* next = tail_->next.load(std::memory_order_acquire);
+        if (!next) return std::nullopt;
+        std::optional<U> value(std::move(next->value));
+        next->value.reset();
+        delete tail_;
+        tail_ = next;
+        return value;
+    }
+
+    bool empty() const { return tail_->next.load(std::memory_order_acquire) == nullptr; }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+private:
+    std::atomic<Node*> head_;
+    Node* tail_;
+};
+
+// Runs posted items one at a time, in order, on an executor. Producers push to an
+// MPSC queue and count the item in `pending_`; only the producer that raises it
+// from zero posts a drain task, and that drain runs until the count falls back to
+// zero, so items for one strand never run concurrently.
+template <typename U>
+class Strand : public std::enable_shared_from_this<Strand<U>> {
+public:
+    Strand(std::shared_ptr<Executor> executor, std::function<void(const U&)> run)
+        : executor_(std::move(executor)), run_(std::move(run)) {}
+
+    void push(U item) {
+        queue_.push(std::move(item));
+        if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+            executor_->post([self = this->shared_from_this()] { self->drain(); });
+        }
+    }
+
+    const std::shared_ptr<Executor>& executor() const { return executor_; }
+
+private:
+    void drain() {
+        do {
+            // A counted item may still be between the two steps of its push.
+            auto item = queue_.pop();
+            while (!item) {
+                std::this_thread::yield();
+                item = queue_.pop();
+            }
+            run_(*item);
+        } while (pending_.fetch_sub(1, std::memory_order_acq_rel) != 1);
+    }
+
+    std::shared_ptr<Executor> executor_;
+    std::function<void(const U&)> run_;
+    MpscQueue<U> queue_;
+    std::atomic<size_t> pending_{0};
+};
+
+} // namespace detail
+
+// Fixed pool of worker threads, each draining its own lock-free MPSC queue.
+// post() picks a worker round-robin. Idle workers park on an atomic wait.
+class ThreadPoolExecutor : public Executor {
+    struct Worker {
+        detail::MpscQueue<std::function<void()>> queue;
+        std::atomic<uint32_t> signal{0};
+        std::thread thread;
+    };
+
+    // Owned jointly by the pool and its workers, so a worker that destroys the
+    // pool (its task held the last reference) keeps running on it.
+    struct State {
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<size_t> next{0};
+        std::atomic<bool> stopping{false};
+    };
+
+public:
+    explicit ThreadPoolExecutor(size_t threads = std::thread::hardware_concurrency()) : state_(std::make_shared<State>()) {
+        if (threads == 0) threads = 1;
+        state_->workers.reserve(threads);
+        for (size_t i = 0; i < threads; i++) state_->workers.push_back(std::make_unique<Worker>());
+        for (auto& worker : state_->workers) {
+            worker->thread = std::thread([state = state_, w = worker.get()] { run(*state, *w); });
+        }
+    }
+
+    // Finishes every task already posted, then joins the workers. Called from a
+    // worker, that worker is detached instead and finishes its queue on its own.
+    ~ThreadPoolExecutor() override {
+        state_->stopping.store(true);
+        for (auto& worker : state_->workers) wake(*worker);
+        for (auto& worker : state_->workers) {
+            if (worker->thread.get_id() == std::this_thread::get_id()) {
+                worker->thread.detach();
+            } else {
+                worker->thread.join();
+            }
+        }
+    }
+
+    void post(std::function<void()> task) override {
+        auto& worker = *state_->workers[state_->next.fetch_add(1, std::memory_order_relaxed) % state_->workers.size()];
+        worker.queue.push(std::move(task));
+        wake(worker);
+    }
+
+    ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+    ThreadPoolExecutor& operator=(const ThreadPoolExecutor&) = delete;
+
+private:
+    static void wake(Worker& worker) {
+        worker.signal.fetch_add(1, std::memory_order_release);
+        worker.signal.notify_one();
+    }
+
+    static void run(State& state, Worker& worker) {
+        for (;;) {
+            // Read the signal before checking the queue so a post in between
+            // changes it and the wait below returns immediately.
+            auto seen = worker.signal.load(std::memory_order_acquire);
+            if (auto task = worker.queue.pop()) {
+                (*task)();
+                continue;
+            }
+            if (state.stopping.load() && worker.queue.empty()) return;
+            worker.signal.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    std::shared_ptr<State> state_;
+};
+
+// Pool whose workers each own a deque of tasks: a worker pops its own newest task
+// first and, when idle, steals the oldest task from another worker. Besides
+// plain post(), parallelFor() splits a range into chunks and lets the calling
+// thread help run them, so it is safe to call from inside the pool.
+class WorkStealingPool : public Executor {
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+        std::thread thread;
+    };
+
+    struct Job {
+        std::atomic<size_t> remaining;
+    };
+
+    // Owned jointly by the pool and its workers, as in ThreadPoolExecutor.
+    struct State {
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<size_t> next{0};
+        std::atomic<uint32_t> signal{0};
+        std::atomic<bool> stopping{false};
+
+        void push(std::function<void()> task) {
+            auto& worker = *workers[next.fetch_add(1, std::memory_order_relaxed) % workers.size()];
+            std::unique_lock lock(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        }
+
+        void wakeAll() {
+            signal.fetch_add(1, std::memory_order_release);
+            signal.notify_all();
+        }
+
+        std::optional<std::function<void()>> popOwn(size_t self) {
+            auto& worker = *workers[self];
+            std::unique_lock lock(worker.mutex);
+            if (worker.tasks.empty()) return std::nullopt;
+            auto task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            return task;
+        }
+
+        // Takes the oldest task from any worker, starting after `self`.
+        std::optional<std::function<void()>> steal(size_t self) {
+            for (size_t i = 0; i < workers.size(); i++) {
+                auto& victim = *workers[(self + i) % workers.size()];
+                std::unique_lock lock(victim.mutex);
+                if (victim.tasks.empty()) continue;
+                auto task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return task;
+            }
+            return std::nullopt;
+        }
+
+        void run(size_t self) {
+            for (;;) {
+                auto seen = signal.load(std::memory_order_acquire);
+                auto task = popOwn(self);
+                if (!task) task = steal(self + 1);
+                if (task) {
+                    (*task)();
+                    continue;
+                }
+                if (stopping.load()) return;
+                signal.wait(seen, std::memory_order_acquire);
+            }
+        }
+    };
+
+public:
+    explicit WorkStealingPool(size_t threads = std::thread::hardware_concurrency()) : state_(std::make_shared<State>()) {
+        if (threads == 0) threads = 1;
+        state_->workers.reserve(threads);
+        for (size_t i = 0; i < threads; i++) state_->workers.push_back(std::make_unique<Worker>());
+        for (size_t i = 0; i < threads; i++) {
+            state_->workers[i]->thread = std::thread([state = state_, i] { state->run(i); });
+        }
+    }
+
+    // Finishes every task already posted, then joins the workers. Called from a
+    // worker, that worker is detached instead and keeps stealing until idle.
+    ~WorkStealingPool() override {
+        state_->stopping.store(true);
+        state_->wakeAll();
+        for (auto& worker : state_->workers) {
+            if (worker->thread.get_id() == std::this_thread::get_id()) {
+                worker->thread.detach();
+            } else {
+                worker->thread.join();
+            }
+        }
+    }
+
+    void post(std::function<void()> task) override {
+        state_->push(std::move(task));
+        state_->signal.fetch_add(1, std::memory_order_release);
+        state_->signal.notify_one();
+    }
+
+    // Runs body(begin, end) over [0, count) in chunks of `chunk` and returns once
+    // every chunk has run. body must not throw.
+    void parallelFor(size_t count, size_t chunk, const std::function<void(size_t, size_t)>& body) {
+        if (count == 0) return;
+        chunk = std::max<size_t>(chunk, 1);
+        auto chunks = (count + chunk - 1) / chunk;
+        // Shared so a worker finishing the last chunk never touches a dead frame.
+        auto job = std::make_shared<Job>();
+        job->remaining.store(chunks, std::memory_order_relaxed);
+
+        for (size_t c = 1; c < chunks; c++) {
+            state_->push([job, &body, begin = c * chunk, end = std::min(count, (c + 1) * chunk)] {
+                body(begin, end);
+                if (job->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) job->remaining.notify_all();
+            });
+        }
+        state_->wakeAll();
+
+        body(0, std::min(count, chunk));
+        job->remaining.fetch_sub(1, std::memory_order_acq_rel);
+
+        // Help with whatever is queued until our chunks are done.
+        for (;;) {
+            auto left = job->remaining.load(std::memory_order_acquire);
+            if (left == 0) return;
+            if (auto task = state_->steal(0)) {
+                (*task)();
+            } else {
+                job->remaining.wait(left, std::memory_order_acquire);
+            }
+        }
+    }
+
+    size_t size() const { return state_->workers.size(); }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+private:
+    std::shared_ptr<State> state_;
+};
@@ -0,0 +1,119 @@
+//
+// Created by Alex Edgar on 13/02/2026.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, size_t Capacity>
+class InplaceFunction;
+
+// Move-only callable that stores its target inside the object and never
+// allocates. A target larger than Capacity bytes, or over-aligned, is a compile
+// error rather than a silent heap fallback.
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+    struct VTable {
+        R (*invoke)(void* target, Args&&... args);
+        void (*move)(void* from, void* to) noexcept;
+        void (*destroy)(void* target) noexcept;
+    };
+
+    template <typename F>
+    static constexpr VTable vtableFor{
+        [](void* target, Args&&... args) -> R { return std::invoke(*static_cast<F*>(target), std::forward<Args>(args)...); },
+        [](void* from, void* to) noexcept {
+            ::new (to) F(std::move(*static_cast<F*>(from)));
+            static_cast<F*>(from)->~F();
+        },
+        [](void* target) noexcept { static_cast<F*>(target)->~F(); },
+    };
+
+public:
+    static constexpr size_t capacity = Capacity;
+
+    InplaceFunction() noexcept = default;
+    InplaceFunction(std::nullptr_t) noexcept {}
+
+    template <typename F, typename D = std::decay_t<F>>
+        requires(!std::is_same_v<D, InplaceFunction> && std::is_invocable_r_v<R, D&, Args...>)
+    InplaceFunction(F&& f) {
+        static_assert(sizeof(D) <= Capacity, "callable does not fit InplaceFunction; shrink the capture or raise Capacity");
+        static_assert(alignof(D) <= alignof(std::max_align_t), "callable is over-aligned for InplaceFunction");
+        static_assert(std::is_nothrow_move_constructible_v<D>, "InplaceFunction targets must be nothrow movable");
+        ::new (static_cast<void*>(storage_)) D(std::forward<F>(f));
+        vtable_ = &vtableFor<D>;
+    }
+
+    InplaceFunction(InplaceFunction&& other) noexcept : vtable_(other.vtable_) {
+        if (vtable_) {
+            vtable_->move(other.storage_, storage_);
+            other.vtable_ = nullptr;
+        }
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.vtable_) {
+                other.vtable_->move(other.storage_, storage_);
+                vtable_ = std::exchange(other.vtable_, nullptr);
+            }
+        }
+        return *this;
+    }
+
+    ~InplaceFunction() { reset(); }
+
+    InplaceFunction(const InplaceFunction&) = delete;
+    InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+    // Like std::function, a const call may run a target with mutable state.
+    R operator()(Args... args) const { return vtable_->invoke(storage_, std::forward<Args>(args)...); }
+
+    explicit operator bool() const noexcept { return vtable_ != nullptr; }
+
+private:
+    void reset() noexcept {
+        if (vtable_) {
+            vtable_->destroy(storage_);
+            vtable_ = nullptr;
+        }
+    }
+
+    const VTable* vtable_{nullptr};
+    alignas(std::max_align_t) mutable std::byte storage_[Capacity];
+};
+
+template <typename Signature>
+class FunctionRef;
+
+// Non-owning reference to a callable: one object pointer and one function
+// pointer, trivially copyable. The referenced callable must outlive every call.
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)> {
+public:
+    FunctionRef() noexcept = default;
+
+    template <typename F>
+        requires(!std::is_same_v<std::remove_cvref_t<F>, FunctionRef> && std::is_invocable_r_v<R, F&, Args...>)
+    FunctionRef(F& f) noexcept
+        : object_(const_cast<void*>(static_cast<const void*>(std::addressof(f)))),
+          invoke_([](void* object, Args&&... args) -> R {
+              return std::invoke(*static_cast<F*>(object), std::forward<Args>(args)...);
+          }) {}
+
+    R operator()(Args... args) const { return invoke_(object_, std::forward<Args>(args)...); }
+
+    explicit operator bool() const noexcept { return invoke_ != nullptr; }
+
+private:
+    void* object_{nullptr};
+    R (*invoke_)(void*, Args&&...){nullptr};
+};
@@ -0,0 +1,462 @@
+//
+// Created by Alex Edgar on 13/02/2026.
+//
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include <bit>
+#include <stdexcept>
+#include <concepts>
+#include <algorithm>
+
+// Immutable collections with structural sharing, meant to be stored in an Atom.
+// Every "modifying" operation returns a new collection that shares all untouched
+// nodes with the old one, so an update copies O(log n) nodes and old snapshots
+// stay valid. An operation that changes nothing returns a collection with the
+// same root, and operator== short-circuits on root identity, so the Atom
+// equality skip costs O(1) for no-op updates.
+
+namespace detail {
+
+inline constexpr unsigned kTrieBits = 5;
+inline constexpr unsigned kTrieWidth = 1u << kTrieBits;
+inline constexpr unsigned kTrieMask = kTrieWidth - 1;
+
+template <typename T>
+bool persistentSame(const T& a, const T& b) {
+    if constexpr (std::equality_comparable<T>) {
+        return a == b;
+    } else {
+        return false;
+    }
+}
+
+} // namespace detail
+
+// Hash array mapped trie in the compressed (CHAMP) layout: each node keeps its
+// inline entries and its child nodes in two bitmap-indexed arrays. Keys whose
+// hashes agree in every bit share a collision node at the bottom.
+template <typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class PersistentMap {
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    struct Node {
+        uint32_t dataMap{0};
+        uint32_t nodeMap{0};
+        std::vector<std::pair<K, V>> entries;  // Collision nodes use entries only
+        std::vector<NodePtr> children;
+    };
+
+    static constexpr unsigned kHashBits = sizeof(size_t) * 8;
+
+public:
+    PersistentMap() : root_(std::make_shared<const Node>()), size_(0) {}
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const V* find(const K& key) const {
+        const Node* node = root_.get();
+        auto hash = Hash{}(key);
+        for (unsigned shift = 0;; shift += detail::kTrieBits) {
+            if (shift >= kHashBits) {
+                for (const auto& entry : node->entries) {
+                    if (KeyEqual{}(entry.first, key)) return &entry.second;
+                }
+                return nullptr;
+            }
+            auto bit = bitFor(hash, shift);
+            if (node->dataMap & bit) {
+                const auto& entry = node->entries[index(node->dataMap, bit)];
+                return KeyEqual{}(entry.first, key) ? &entry.second : nullptr;
+            }
+            if (!(node->nodeMap & bit)) return nullptr;
+            node = node->children[index(node->nodeMap, bit)].get();
+        }
+    }
+
+    bool contains(const K& key) const { return find(key) != nullptr; }
+
+    const V& at(const K& key) const {
+        if (auto* value = find(key)) return *value;
+        throw std::out_of_range("PersistentMap::at");
+    }
+
+    PersistentMap set(K key, V value) const {
+        bool added = false;
+        auto hash = Hash{}(key);
+        auto root = insert(root_, std::move(key), std::move(value), hash, 0, added);
+        return PersistentMap(std::move(root), size_ + (added ? 1 : 0));
+    }
+
+    PersistentMap erase(const K& key) const {
+        bool removed = false;
+        auto root = remove(root_, key, Hash{}(key), 0, removed);
+        return PersistentMap(std::move(root), size_ - (removed ? 1 : 0));
+    }
+
+    // Visits every entry as fn(key, value), in hash order.
+    template <typename F>
+    void forEach(F&& fn) const {
+        visit(*root_, fn);
+    }
+
+    bool operator==(const PersistentMap& other) const {
+        if (root_ == other.root_) return true;
+        if (size_ != other.size_) return false;
+        bool equal = true;
+        forEach([&](const K& key, const V& value) {
+            if (!equal) return;
+            auto* theirs = other.find(key);
+            equal = theirs && detail::persistentSame(value, *theirs);
+        });
+        return equal;
+    }
+
+    // True when both maps are the same version, without comparing contents.
+    bool identical(const PersistentMap& other) const { return root_ == other.root_; }
+
+private:
+    PersistentMap(NodePtr root, size_t size) : root_(std::move(root)), size_(size) {}
+
+    static uint32_t bitFor(size_t hash, unsigned shift) {
+        return 1u << ((hash >> shift) & detail::kTrieMask);
+    }
+
+    static size_t index(uint32_t map, uint32_t bit) {
+        return std::popcount(map & (bit - 1));
+    }
+
+    static NodePtr mergeTwo(std::pair<K, V> a, size_t hashA, std::pair<K, V> b, size_t hashB, unsigned shift) {
+        auto node = std::make_shared<Node>();
+        if (shift >= kHashBits) {
+            node->entries.push_back(std::move(a));
+            node->entries.push_back(std::move(b));
+            return node;
+        }
+        auto bitA = bitFor(hashA, shift);
+        auto bitB = bitFor(hashB, shift);
+        if (bitA == bitB) {
+            node->nodeMap = bitA;
+            node->children.push_back(mergeTwo(std::move(a), hashA, std::move(b), hashB, shift + detail::kTrieBits));
+            return node;
+        }
+        node->dataMap = bitA | bitB;
+        if (bitA < bitB) {
+            node->entries.push_back(std::move(a));
+            node->entries.push_back(std::move(b));
+        } else {
+            node->entries.push_back(std::move(b));
+            node->entries.push_back(std::move(a));
+        }
+        return node;
+    }
+
+    // Returns node itself when nothing changed.
+    static NodePtr insert(const NodePtr& node, K key, V value, size_t hash, unsigned shift, bool& added) {
+        if (shift >= kHashBits) {
+            for (size_t i = 0; i < node->entries.size(); i++) {
+                if (KeyEqual{}(node->entries[i].first, key)) {
+                    if (detail::persistentSame(node->entries[i].second, value)) return node;
+                    auto copy = std::make_shared<Node>(*node);
+                    copy->entries[i].second = std::move(value);
+                    return copy;
+                }
+            }
+            auto copy = std::make_shared<Node>(*node);
+            copy->entries.emplace_back(std::move(key), std::move(value));
+            added = true;
+            return copy;
+        }
+
+        auto bit = bitFor(hash, shift);
+        if (node->dataMap & bit) {
+            auto i = index(node->dataMap, bit);
+            const auto& existing = node->entries[i];
+            if (KeyEqual{}(existing.first, key)) {
+                if (detail::persistentSame(existing.second, value)) return node;
+                auto copy = std::make_shared<Node>(*node);
+                copy->entries[i].second = std::move(value);
+                return copy;
+            }
+            auto child = mergeTwo(existing, Hash{}(existing.first), {std::move(key), std::move(value)}, hash, shift + detail::kTrieBits);
+            auto copy = std::make_shared<Node>(*node);
+            copy->entries.erase(copy->entries.begin() + i);
+            copy->dataMap &= ~bit;
+            copy->nodeMap |= bit;
+            copy->children.insert(copy->children.begin() + index(copy->nodeMap, bit), std::move(child));
+            added = true;
+            return copy;
+        }
+        if (node->nodeMap & bit) {
+            auto i = index(node->nodeMap, bit);
+            auto child = insert(node->children[i], std::move(key), std::move(value), hash, shift + detail::kTrieBits, added);
+            if (child == node->children[i]) return node;
+            auto copy = std::make_shared<Node>(*node);
+            copy->children[i] = std::move(child);
+            return copy;
+        }
+        auto copy = std::make_shared<Node>(*node);
+        copy->dataMap |= bit;
+        copy->entries.insert(copy->entries.begin() + index(copy->dataMap, bit), {std::move(key), std::move(value)});
+        added = true;
+        return copy;
+    }
+
+    // Returns node itself when nothing changed. Children left holding a single
+    // entry are pulled up into their parent to keep the trie canonical.
+    static NodePtr remove(const NodePtr& node, const K& key, size_t hash, unsigned shift, bool& removed) {
+        if (shift >= kHashBits) {
+            for (size_t i = 0; i < node->entries.size(); i++) {
+                if (KeyEqual{}(node->entries[i].first, key)) {
+                    auto copy = std::make_shared<Node>(*node);
+                    copy->entries.erase(copy->entries.begin() + i);
+                    removed = true;
+                    return copy;
+                }
+            }
+            return node;
+        }
+
+        auto bit = bitFor(hash, shift);
+        if (node->dataMap & bit) {
+            auto i = index(node->dataMap, bit);
+            if (!KeyEqual{}(node->entries[i].first, key)) return node;
+            auto copy = std::make_shared<Node>(*node);
+            copy->entries.erase(copy->entries.begin() + i);
+            copy->dataMap &= ~bit;
+            removed = true;
+            return copy;
+        }
+        if (node->nodeMap & bit) {
+            auto i = index(node->nodeMap, bit);
+            auto child = remove(node->children[i], key, hash, shift + detail::kTrieBits, removed);
+            if (child == node->children[i]) return node;
+            auto copy = std::make_shared<Node>(*node);
+            if (child->children.empty() && child->entries.size() == 1) {
+                copy->children.erase(copy->children.begin() + i);
+                copy->nodeMap &= ~bit;
+                copy->dataMap |= bit;
+                copy->entries.insert(copy->entries.begin() + index(copy->dataMap, bit), child->entries.front());
+            } else {
+                copy->children[i] = std::move(child);
+            }
+            return copy;
+        }
+        return node;
+    }
+
+    template <typename F>
+    static void visit(const Node& node, F& fn) {
+        for (const auto& [key, value] : node.entries) fn(key, value);
+        for (const auto& child : node.children) visit(*child, fn);
+    }
+
+    NodePtr root_;
+    size_t size_;
+};
+
+// Persistent vector as a 32-way bit-partitioned trie with a detached tail, so
+// push_back and pop_back are amortised O(1) and indexed reads and writes are
+// O(log32 n). This is the RRB layout without relaxed (size-table) nodes, which
+// only concatenation and mid-vector insertion need.
+template <typename T>
+class PersistentVector {
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    struct Node {
+        std::vector<NodePtr> children;  // Internal nodes
+        std::vector<T> values;          // Leaves
+    };
+
+public:
+    PersistentVector() : root_(std::make_shared<const Node>()), tail_(std::make_shared<const Node>()) {}
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const T& operator[](size_t i) const { return leafFor(i).values[i & detail::kTrieMask]; }
+
+    const T& at(size_t i) const {
+        if (i >= size_) throw std::out_of_range("PersistentVector::at");
+        return (*this)[i];
+    }
+
+    const T& back() const { return (*this)[size_ - 1]; }
+
+    PersistentVector pushBack(T value) const {
+        if (size_ - tailOffset() < detail::kTrieWidth) {
+            auto tail = std::make_shared<Node>(*tail_);
+            tail->values.push_back(std::move(value));
+            return PersistentVector(size_ + 1, shift_, root_, std::move(tail));
+        }
+
+        // The tail is full: push it into the trie, growing a level if the root is full.
+        NodePtr root;
+        auto shift = shift_;
+        if ((size_ >> detail::kTrieBits) > (size_t{1} << shift_)) {
+            auto grown = std::make_shared<Node>();
+            grown->children.push_back(root_);
+            grown->children.push_back(newPath(shift_, tail_));
+            root = std::move(grown);
+            shift += detail::kTrieBits;
+        } else {
+            root = pushTail(shift_, *root_, tail_);
+        }
+        auto tail = std::make_shared<Node>();
+        tail->values.push_back(std::move(value));
+        return PersistentVector(size_ + 1, shift, std::move(root), std::move(tail));
+    }
+
+    // Returns *this (same root and tail) when the value is unchanged.
+    PersistentVector set(size_t i, T value) const {
+        if (i >= size_) throw std::out_of_range("PersistentVector::set");
+        if (detail::persistentSame((*this)[i], value)) return *this;
+        if (i >= tailOffset()) {
+            auto tail = std::make_shared<Node>(*tail_);
+            tail->values[i & detail::kTrieMask] = std::move(value);
+            return PersistentVector(size_, shift_, root_, std::move(tail));
+        }
+        return PersistentVector(size_, shift_, assoc(shift_, *root_, i, std::move(value)), tail_);
+    }
+
+    PersistentVector popBack() const {
+        if (size_ == 0) throw std::out_of_range("PersistentVector::popBack");
+        if (size_ == 1) return PersistentVector();
+        if (size_ - tailOffset() > 1) {
+            auto tail = std::make_shared<Node>(*tail_);
+            tail->values.pop_back();
+            return PersistentVector(size_ - 1, shift_, root_, std::move(tail));
+        }
+
+        // The tail empties: the last leaf in the trie becomes the new tail.
+        auto tail = leafPtrFor(size_ - 2);
+        auto root = popTail(shift_, *root_);
+        auto shift = shift_;
+        if (!root) root = std::make_shared<const Node>();
+        if (shift > detail::kTrieBits && root->children.size() == 1) {
+            root = root->children.front();
+            shift -= detail::kTrieBits;
+        }
+        return PersistentVector(size_ - 1, shift, std::move(root), std::move(tail));
+    }
+
+    template <typename F>
+    void forEach(F&& fn) const {
+        for (size_t i = 0; i < size_; i += detail::kTrieWidth) {
+            for (const auto& value : leafFor(i).values) fn(value);
+        }
+    }
+
+    std::vector<T> toVector() const {
+        std::vector<T> out;
+        out.reserve(size_);
+        forEach([&](const T& value) { out.push_back(value); });
+        return out;
+    }
+
+    bool operator==(const PersistentVector& other) const {
+        if (root_ == other.root_ && tail_ == other.tail_) return true;
+        if (size_ != other.size_) return false;
+        for (size_t i = 0; i < size_; i += detail::kTrieWidth) {
+            const auto& a = leafFor(i);
+            const auto& b = other.leafFor(i);
+            if (&a == &b) continue;  // Shared leaf
+            if (!std::equal(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+                            [](const T& x, const T& y) { return detail::persistentSame(x, y); })) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool identical(const PersistentVector& other) const { return root_ == other.root_ && tail_ == other.tail_; }
+
+private:
+    PersistentVector(size_t size, unsigned shift, NodePtr root, NodePtr tail)
+        : size_(size), shift_(shift), root_(std::move(root)), tail_(std::move(tail)) {}
+
+    size_t tailOffset() const {
+        return size_ < detail::kTrieWidth ? 0 : ((size_ - 1) >> detail::kTrieBits) << detail::kTrieBits;
+    }
+
+    const NodePtr& leafPtrFor(size_t i) const {
+        if (i >= tailOffset()) return tail_;
+        const NodePtr* node = &root_;
+        for (auto level = shift_; level > 0; level -= detail::kTrieBits) {
+            node = &(*node)->children[(i >> level) & detail::kTrieMask];
+        }
+        return *node;
+    }
+
+    const Node& leafFor(size_t i) const { return *leafPtrFor(i); }
+
+    static NodePtr newPath(unsigned level, NodePtr node) {
+        if (level == 0) return node;
+        auto parent = std::make_shared<Node>();
+        parent->children.push_back(newPath(level - detail::kTrieBits, std::move(node)));
+        return parent;
+    }
+
+    NodePtr pushTail(unsigned level, const Node& parent, const NodePtr& tail) const {
+        auto copy = std::make_shared<Node>(parent);
+        auto subidx = ((size_ - 1) >> level) & detail::kTrieMask;
+        NodePtr child;
+        if (level == detail::kTrieBits) {
+            child = tail;
+        } else if (subidx < parent.children.size()) {
+            child = pushTail(level - detail::kTrieBits, *parent.children[subidx], tail);
+        } else {
+            child = newPath(level - detail::kTrieBits, tail);
+        }
+        if (subidx < copy->children.size()) {
+            copy->children[subidx] = std::move(child);
+        } else {
+            copy->children.push_back(std::move(child));
+        }
+        return copy;
+    }
+
+    static NodePtr assoc(unsigned level, const Node& node, size_t i, T value) {
+        auto copy = std::make_shared<Node>(node);
+        if (level == 0) {
+            copy->values[i & detail::kTrieMask] = std::move(value);
+        } else {
+            auto subidx = (i >> level) & detail::kTrieMask;
+            copy->children[subidx] = assoc(level - detail::kTrieBits, *node.children[subidx], i, std::move(value));
+        }
+        return copy;
+    }
+
+    // Drops the rightmost leaf; returns null when the node ends up empty.
+    NodePtr popTail(unsigned level, const Node& node) const {
+        auto subidx = ((size_ - 2) >> level) & detail::kTrieMask;
+        if (level > detail::kTrieBits) {
+            auto child = popTail(level - detail::kTrieBits, *node.children[subidx]);
+            if (!child && subidx == 0) return nullptr;
+            auto copy = std::make_shared<Node>(node);
+            if (child) {
+                copy->children[subidx] = std::move(child);
+            } else {
+                copy->children.resize(subidx);
+            }
+            return copy;
+        }
+        if (subidx == 0) return nullptr;
+        auto copy = std::make_shared<Node>(node);
+        copy->children.resize(subidx);
+        return copy;
+    }
+
+    size_t size_{0};
+    unsigned shift_{detail::kTrieBits};
+    NodePtr root_;
+    NodePtr tail_;
+};
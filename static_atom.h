@@ -0,0 +1,82 @@
+//
+// Created by Alex Edgar on 13/02/2026.
+//
+
+#pragma once
+
+#include "atom.h"
+
+// Atom whose listeners are fixed at compile time, for wiring that never changes
+// at run time. Listeners are template arguments (function pointers or
+// captureless lambdas) called directly in declaration order, so notifying is a
+// straight-line sequence of inlinable calls with no type erasure, no listener
+// list and no allocation. The write itself is allocation-free only for the
+// inline storage policies (scalars and small trivially copyable values); any
+// other T gets a newly allocated snapshot per write, as in Atom. Listeners
+// declared noexcept are called without a try/catch; exceptions from the others
+// go to onError.
+//
+// Writes notify immediately: StaticAtom does not take part in Batch or
+// Transaction, and has no run-time subscriptions.
+template <typename T, auto... Listeners>
+    requires(std::is_invocable_v<decltype(Listeners), const T&> && ...)
+class StaticAtom {
+    using Storage = detail::StorageFor<T, DefaultEquality>;
+    using Version = typename Storage::Version;
+
+public:
+    // True when every listener is noexcept, so notification has no exception handling.
+    static constexpr bool nothrowNotify = (std::is_nothrow_invocable_v<decltype(Listeners), const T&> && ...);
+
+    explicit StaticAtom(T initial, std::function<void(std::exception_ptr)> onError = nullptr)
+        : storage_(std::move(initial)), on_error_(std::move(onError)) {}
+
+    T get() const { return storage_.load(); }
+
+    std::shared_ptr<const T> snapshot() const { return storage_.snapshot(); }
+
+    void set(T value) {
+        if (auto committed = storage_.replace(std::move(value))) notify(*committed);
+    }
+
+    template <typename F>
+    void update(F&& updater) {
+        if (auto committed = storage_.modify(std::forward<F>(updater))) notify(*committed);
+    }
+
+    // Edits a copy of the current value. The mutator reports whether it changed
+    // anything, which replaces the equality check, so no comparison is made.
+    // The copy is still a full copy of T: readers may hold the current version,
+    // so it is never edited where it stands, and adding one entry to a large
+    // std::unordered_map costs O(n). Store a PersistentMap or PersistentVector
+    // (persistent.h) for O(log n) edits that share structure. Listeners are
+    // only notified when the mutator returns true.
+    template <typename F>
+    void mutate(F&& mutator) {
+        if (auto committed = storage_.mutate(std::forward<F>(mutator))) notify(*committed);
+    }
+
+    StaticAtom(const StaticAtom&) = delete;
+    StaticAtom& operator=(const StaticAtom&) = delete;
+
+private:
+    void notify(const T& value) {
+        (deliver<Listeners>(value), ...);
+    }
+
+    template <auto Listener>
+    void deliver(const T& value) {
+        if constexpr (std::is_nothrow_invocable_v<decltype(Listener), const T&>) {
+            Listener(value);
+        } else {
+            try {
+                Listener(value);
+            } catch (...) {
+                if (on_error_) on_error_(std::current_exception());
+            }
+        }
+    }
+
+    Storage storage_;
+    std::function<void(std::exception_ptr)> on_error_;
+};
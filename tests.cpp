@@ -9,6 +9,16 @@
 #include <atomic>
 #include <string>
 #include "atom.h"
+#include "atom_collections.h"
+#include "persistent.h"
+#include "static_atom.h"
+#include "derived.h"
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
 
 // Error handler
 auto testErrorHandler = [](const std::exception_ptr& e) {
@@ -44,6 +54,95 @@ void test_multiple_updates() {
     assert(atom->get() == 100);
 }
 
+void test_update_optimistic() {
+    auto atom = createAtom<std::string>("a", testErrorHandler);
+    int count = 0;
+    auto sub = atom->subscribe([&](const std::string&) { count++; });
+    atom->updateOptimistic([](const std::string& s) { return s + "b"; });
+    atom->updateOptimistic([](const std::string& s) { return s; });
+    assert(atom->get() == "ab");
+    assert(count == 1);
+    auto stats = atom->optimisticStats();
+    assert(stats.commits == 1);
+    assert(stats.conflicts == 0);
+}
+
+void test_update_combining() {
+    auto atom = createAtom<std::string>("a", testErrorHandler);
+    std::string received;
+    auto sub = atom->subscribe([&](const std::string& v) { received = v; });
+    atom->updateCombining([](const std::string& s) { return s + "b"; });
+    assert(atom->get() == "ab");
+    assert(received == "ab");
+}
+
+void test_update_combining_rethrows() {
+    auto atom = createAtom<std::string>("a", testErrorHandler);
+    bool threw = false;
+    try {
+        atom->updateCombining([](const std::string&) -> std::string { throw std::runtime_error("bad"); });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(atom->get() == "a");
+}
+
+// Copying throws, so a combiner cannot even start from the current value.
+struct UncopyableWhenArmed {
+    static inline std::atomic<bool> armed{false};
+    int value;
+
+    explicit UncopyableWhenArmed(int v) : value(v) {}
+    UncopyableWhenArmed(const UncopyableWhenArmed& other) : value(other.value) {
+        if (armed) throw std::runtime_error("copy failed");
+    }
+    UncopyableWhenArmed(UncopyableWhenArmed&&) noexcept = default;
+    UncopyableWhenArmed& operator=(const UncopyableWhenArmed&) = default;
+    bool operator==(const UncopyableWhenArmed&) const = default;
+};
+
+void test_update_combining_failed_publish_fails_every_request() {
+    auto atom = createAtom<UncopyableWhenArmed>(UncopyableWhenArmed(0), testErrorHandler);
+    UncopyableWhenArmed::armed = true;
+    std::atomic<int> returned{0}, threw{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 200; i++) {
+                try {
+                    atom->updateCombining([](const UncopyableWhenArmed& v) { return UncopyableWhenArmed(v.value + 1); });
+                    returned++;
+                } catch (const std::runtime_error&) {
+                    threw++;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    UncopyableWhenArmed::armed = false;
+    assert(returned == 0 && threw == 800);  // Drained requests are not reported as applied
+    assert(atom->get().value == 0);
+}
+
+void test_mutate() {
+    auto atom = createAtom<std::vector<int>>({1, 2}, testErrorHandler);
+    int count = 0;
+    auto sub = atom->subscribe([&](const std::vector<int>&) { count++; });
+    atom->mutate([](std::vector<int>& v) { v.push_back(3); return true; });
+    atom->mutate([](std::vector<int>&) { return false; });
+    assert((atom->get() == std::vector<int>{1, 2, 3}));
+    assert(count == 1);
+}
+
+void test_mutate_keeps_old_snapshot() {
+    auto atom = createAtom<std::string>("abc", testErrorHandler);
+    auto before = atom->snapshot();
+    atom->mutate([](std::string& s) { s += "d"; return true; });
+    assert(*before == "abc");
+    assert(atom->get() == "abcd");
+}
+
 // Subscription
 void test_subscribe_fires() {
     auto atom = createAtom<int>(0, testErrorHandler);
@@ -128,6 +227,131 @@ void test_move_assign_subscription() {
     assert(countB == 1);  // Mew listener fired
 }
 
+void test_unsubscribe_during_notify() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    int count = 0;
+    Subscription<int> sub = Subscription<int>(std::weak_ptr<Atom<int>>{}, {});
+    sub = atom->subscribe([&](const int&) {
+        count++;
+        sub.unsubscribe();  // Listener list being iterated is an immutable snapshot
+    });
+    atom->set(1);
+    atom->set(2);
+    assert(count == 1);
+}
+
+void test_unsubscribe_reuses_slots() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    std::vector<int> fired(6, 0);
+    std::vector<Subscription<int>> subs;
+    for (int i = 0; i < 4; i++) subs.push_back(atom->subscribe([&, i](const int&) { fired[i]++; }));
+    subs[1].unsubscribe();
+    subs[0].unsubscribe();  // Swap-removal moves the last listener around
+    // New listeners reuse the freed slots with a new generation.
+    subs.push_back(atom->subscribe([&](const int&) { fired[4]++; }));
+    subs.push_back(atom->subscribe([&](const int&) { fired[5]++; }));
+    atom->set(1);
+    assert((fired == std::vector<int>{0, 0, 1, 1, 1, 1}));
+    subs[3].unsubscribe();
+    subs[4].unsubscribe();
+    atom->set(2);
+    assert((fired == std::vector<int>{0, 0, 2, 1, 1, 2}));
+}
+
+void test_unsubscribe_across_listener_chunks() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    std::vector<int> calls(150, 0);
+    std::vector<Subscription<int>> subs;
+    for (size_t i = 0; i < calls.size(); i++) subs.push_back(atom->subscribe([&calls, i](const int&) { calls[i]++; }));
+    std::vector<size_t> removed{149, 0, 64, 127, 5, 128};  // Tail, heads and ends of chunks
+    for (auto i : removed) subs[i].unsubscribe();
+    atom->set(1);
+    for (size_t i = 0; i < calls.size(); i++) {
+        bool gone = std::find(removed.begin(), removed.end(), i) != removed.end();
+        assert(calls[i] == (gone ? 0 : 1));
+    }
+    subs.push_back(atom->subscribe([&calls](const int&) { calls[0] += 10; }));
+    atom->set(2);
+    assert(calls[0] == 10 && calls[1] == 2);
+}
+
+void test_unsubscribe_across_listener_pages() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    std::vector<int> calls(4200, 0);  // A page holds 64 chunks of 64
+    std::vector<Subscription<int>> subs;
+    for (size_t i = 0; i < calls.size(); i++) subs.push_back(atom->subscribe([&calls, i](const int&) { calls[i]++; }));
+    std::vector<size_t> removed{4095, 0, 4096, 4199};  // Page ends, heads and the tail
+    for (auto i : removed) subs[i].unsubscribe();
+    atom->set(1);
+    for (size_t i = 0; i < calls.size(); i++) {
+        bool gone = std::find(removed.begin(), removed.end(), i) != removed.end();
+        assert(calls[i] == (gone ? 0 : 1));
+    }
+    for (size_t i = 4000; i < calls.size(); i++) subs[i].unsubscribe();  // Drops the second page
+    atom->set(2);
+    assert(atom->listenerCount() == 3999);
+    int total = 0;
+    for (auto c : calls) total += c;
+    assert(total == 4196 + 3999);
+}
+
+void test_many_subscribers_then_unsubscribe() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    int count = 0;
+    std::vector<Subscription<int>> subs;
+    for (int i = 0; i < 10000; i++) subs.push_back(atom->subscribe([&](const int&) { count++; }));
+    atom->set(1);
+    assert(count == 10000);
+    for (size_t i = 0; i < subs.size(); i += 2) subs[i].unsubscribe();
+    atom->set(2);
+    assert(count == 15000);
+}
+
+void test_subscribe_ref() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    int received = -1;
+    auto listener = [&](const int& v) { received = v; };
+    auto sub = atom->subscribeRef(listener);
+    atom->set(5);
+    assert(received == 5);
+    sub.unsubscribe();
+    atom->set(6);
+    assert(received == 5);
+}
+
+void test_subscribe_ref_in_flight_after_unsubscribe() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    std::atomic<bool> entered{false}, release{false};
+    auto blocker = atom->subscribe([&](const int&) {
+        entered = true;
+        while (!release) std::this_thread::yield();
+    });
+    std::atomic<int> refCalls{0};
+    auto listener = [&](const int&) { refCalls++; };
+    auto sub = atom->subscribeRef(listener);
+
+    std::thread writer([&] { atom->set(1); });
+    while (!entered) std::this_thread::yield();
+    sub.unsubscribe();  // The write already holds the old listener list
+    release = true;
+    writer.join();
+    assert(refCalls == 1);  // So listener had to outlive the write, not the subscription
+    atom->set(2);
+    assert(refCalls == 1);
+}
+
+void test_inplace_function_moves_target() {
+    auto counter = std::make_shared<int>(0);
+    InplaceFunction<int(int), 32> f = [counter](int by) { return *counter += by; };
+    assert(f(2) == 2);
+    auto g = std::move(f);
+    assert(!f && g);
+    assert(g(3) == 5);
+    assert(counter.use_count() == 2);
+    g = nullptr;
+    assert(counter.use_count() == 1);  // Target destroyed, not leaked
+}
+
 // Equality skip
 void test_skip_equal_set() {
     auto atom = createAtom<int>(5, testErrorHandler);
@@ -145,6 +369,89 @@ void test_skip_equal_update() {
     assert(count == 0);
 }
 
+void test_lock_free_skipped_write_keeps_value() {
+    auto atom = createAtom<double>(0.0, testErrorHandler);
+    static_assert(detail::useAtomic<double>);
+    int count = 0;
+    auto sub = atom->subscribe([&](const double&) { count++; });
+    atom->set(-0.0);  // Equal to 0.0, so skipped
+    assert(count == 0 && atom->version() == 0);
+    assert(!std::signbit(atom->get()));  // And not stored either
+}
+
+struct Config {
+    int revision;
+    std::string body;
+};
+
+void test_identity_equality_always_notifies() {
+    auto atom = createAtom<int, IdentityEquality>(5, testErrorHandler);
+    int count = 0;
+    auto sub = atom->subscribe([&](const int&) { count++; });
+    atom->set(5);
+    assert(count == 1);
+}
+
+void test_field_equality_compares_revision() {
+    auto atom = createAtom<Config, FieldEquality<&Config::revision>>({1, "a"}, testErrorHandler);
+    int count = 0;
+    auto sub = atom->subscribe([&](const Config&) { count++; });
+    atom->set({1, "ignored"});
+    assert(count == 0);
+    assert(atom->get().body == "a");
+    atom->set({2, "b"});
+    assert(count == 1);
+}
+
+struct Px {
+    int revision;
+    int price;
+};
+
+void test_field_equality_lock_free() {
+    auto atom = createAtom<Px, FieldEquality<&Px::revision>>({1, 100}, testErrorHandler);
+    static_assert(detail::useAtomic<Px>);
+    int count = 0;
+    auto sub = atom->subscribe([&](const Px&) { count++; });
+    atom->set({1, 200});  // Same revision: skipped, not stored
+    assert(count == 0 && atom->version() == 0);
+    assert(atom->get().price == 100);
+    atom->set({2, 200});
+    assert(count == 1 && atom->get().price == 200);
+}
+
+// Carries its hash, so HashEquality never rehashes the text.
+struct HashedText {
+    std::string text;
+    uint64_t digest;
+
+    uint64_t hash() const { return digest; }
+    bool operator==(const HashedText& other) const { return text == other.text; }
+};
+
+void test_hash_equality_uses_carried_hash() {
+    auto atom = createAtom<HashedText, HashEquality>({"a", 1}, testErrorHandler);
+    int count = 0;
+    auto sub = atom->subscribe([&](const HashedText&) { count++; });
+    atom->set({"a", 1});  // Same hash, confirmed equal
+    assert(count == 0);
+    atom->set({"a", 2});  // Differing hashes decide without comparing text
+    assert(count == 1);
+}
+
+void test_hash_equality() {
+    auto atom = createAtom<std::string, HashEquality>("hello", testErrorHandler);
+    int count = 0;
+    Subscription<std::string, HashEquality> sub = atom->subscribe([&](const std::string&) { count++; });
+    atom->set("hello");
+    atom->update([](const std::string& s) { return s; });
+    assert(count == 0);
+    atom->set("world");
+    atom->mutate([](std::string& s) { s += "!"; return true; });
+    atom->set("world!");
+    assert(count == 2);
+}
+
 // Type issues
 void test_string_atom() {
     auto atom = createAtom<std::string>("hello", testErrorHandler);
@@ -196,7 +503,7 @@ void test_error_handler_receives_exception() {
 
 // Lifetime
 void test_subscription_outlives_atom() {
-    Subscription<int> sub = Subscription<int>(std::weak_ptr<Atom<int>>{}, 0);
+    Subscription<int> sub = Subscription<int>(std::weak_ptr<Atom<int>>{}, {});
     {
         auto atom = createAtom<int>(0, testErrorHandler);
         sub = atom->subscribe([](const int&) {});
@@ -204,119 +511,1510 @@ void test_subscription_outlives_atom() {
     // Atom is dead, sub destructor should not crash
 }
 
-// Concurrency
-void test_concurrent_writes() {
+// Snapshot
+void test_snapshot_reflects_value() {
+    auto atom = createAtom<std::string>("hello", testErrorHandler);
+    auto snap = atom->snapshot();
+    assert(*snap == "hello");
+    atom->set("world");
+    assert(*snap == "hello");  // Old snapshot is immutable
+    assert(*atom->snapshot() == "world");
+}
+
+void test_snapshot_shared_when_unchanged() {
+    auto atom = createAtom<std::vector<int>>({1, 2, 3}, testErrorHandler);
+    auto a = atom->snapshot();
+    atom->set({1, 2, 3});  // Equal, so no new version is installed
+    assert(a == atom->snapshot());
+}
+
+void test_subscribe_snapshot_shares_version() {
+    auto atom = createAtom<std::vector<int>>({1, 2, 3}, testErrorHandler);
+    std::shared_ptr<const std::vector<int>> received;
+    auto sub = atom->subscribeSnapshot([&](const std::shared_ptr<const std::vector<int>>& v) { received = v; });
+    atom->set({4, 5, 6});
+    assert(received == atom->snapshot());  // Same object, no copy
+    atom->set({7, 8, 9});
+    assert((*received == std::vector<int>{7, 8, 9}));
+}
+
+void test_subscribe_snapshot_inline_value() {
     auto atom = createAtom<int>(0, testErrorHandler);
-    std::atomic<int> notifications{0};
-    auto sub = atom->subscribe([&](const int&) { notifications++; });
+    int received = -1;
+    auto sub = atom->subscribeSnapshot([&](const std::shared_ptr<const int>& v) { received = *v; });
+    atom->set(42);
+    assert(received == 42);
+}
 
-    std::vector<std::thread> threads;
-    for (int i = 0; i < 10; i++) {
-        threads.emplace_back([&, i]() {
-            for (int j = 0; j < 1000; j++) {
-                atom->set(i * 1000 + j);
-            }
-        });
+// Conflation
+// Executor whose tasks run only when the test calls runAll().
+struct ManualExecutor : Executor {
+    std::vector<std::function<void()>> tasks;
+    void post(std::function<void()> task) override { tasks.push_back(std::move(task)); }
+    void runAll() {
+        auto pending = std::move(tasks);
+        tasks.clear();
+        for (auto& task : pending) task();
     }
-    for (auto& t : threads) t.join();
-    // No crashes, no deadlocks
+};
+
+void test_conflated_delivers_latest_only() {
+    auto atom = createAtom<std::string>("", testErrorHandler);
+    auto executor = std::make_shared<ManualExecutor>();
+    std::vector<std::string> received;
+    auto sub = atom->subscribeConflated([&](const std::string& v) { received.push_back(v); }, executor);
+    atom->set("a");
+    atom->set("b");
+    atom->set("c");
+    assert(executor->tasks.size() == 1);  // One pending delivery at most
+    executor->runAll();
+    assert((received == std::vector<std::string>{"c"}));
+    assert(sub.conflated() == 2);
+    assert(sub.delivered() == 1);
+
+    atom->set("d");
+    assert(executor->tasks.size() == 1);
+    executor->runAll();
+    assert(received.back() == "d");
 }
 
-void test_concurrent_subscribe_unsubscribe() {
+void test_conflated_inline_executor() {
     auto atom = createAtom<int>(0, testErrorHandler);
-    std::vector<std::thread> threads;
+    int count = 0;
+    auto inlineSub = atom->subscribeConflated([&](const int&) { count++; }, std::make_shared<InlineExecutor>());
+    auto nullSub = atom->subscribeConflated([&](const int&) { count++; }, nullptr);
+    atom->set(1);
+    atom->set(2);
+    assert(count == 4);
+    assert(inlineSub.conflated() == 0 && nullSub.conflated() == 0);
+}
 
-    for (int i = 0; i < 10; i++) {
-        threads.emplace_back([&]() {
-            for (int j = 0; j < 100; j++) {
-                auto sub = atom->subscribe([](const int&) {});
-                atom->set(j);
-            }
-        });
-    }
-    for (auto& t : threads) t.join();
+// Queued subscriptions
+
+void test_queued_delivers_every_value() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    auto executor = std::make_shared<ManualExecutor>();
+    std::vector<int> received;
+    auto sub = atom->subscribeQueued([&](const int& v) { received.push_back(v); }, executor, 8);
+    for (int i = 1; i <= 5; i++) atom->set(i);
+    assert(executor->tasks.size() == 1);  // One drain in flight
+    assert(sub.depth() == 5);
+    executor->runAll();
+    assert((received == std::vector<int>{1, 2, 3, 4, 5}));
+    assert(sub.depth() == 0);
+    assert(sub.highWaterMark() == 5);
+    assert(sub.delivered() == 5);
 }
 
-void test_concurrent_reads_and_writes() {
+void test_queued_drop_oldest() {
+    auto atom = createAtom<std::string>("", testErrorHandler);
+    auto executor = std::make_shared<ManualExecutor>();
+    std::vector<std::string> received;
+    auto sub = atom->subscribeQueued([&](const std::string& v) { received.push_back(v); }, executor, 3,
+                                     OverflowPolicy::DropOldest);
+    for (int i = 1; i <= 5; i++) atom->set(std::to_string(i));
+    assert(sub.dropped() == 2);
+    assert(sub.depth() == 3);
+    executor->runAll();
+    assert((received == std::vector<std::string>{"3", "4", "5"}));
+}
+
+void test_queued_fail_throws_after_wave() {
     auto atom = createAtom<int>(0, testErrorHandler);
-    std::atomic<bool> done{false};
+    auto executor = std::make_shared<ManualExecutor>();
+    int plain = 0;
+    auto sub = atom->subscribeQueued([](const int&) {}, executor, 2, OverflowPolicy::Fail);
+    auto other = atom->subscribe([&](const int& v) { plain = v; });
+    atom->set(1);
+    atom->set(2);
+    bool threw = false;
+    try {
+        atom->set(3);
+    } catch (const QueueOverflow&) {
+        threw = true;
+    }
+    assert(threw);
+    assert(atom->get() == 3 && plain == 3);  // Committed and delivered elsewhere
+    assert(sub.rejected() == 1 && sub.depth() == 2);
+}
 
-    std::vector<std::thread> readers;
-    for (int i = 0; i < 5; i++) {
-        readers.emplace_back([&]() {
-            while (!done) {
-                volatile int v = atom->get();
-                (void)v;
-            }
-        });
+void test_listener_overflow_goes_to_on_error() {
+    auto dst = createAtom<int>(0, testErrorHandler);
+    auto executor = std::make_shared<ManualExecutor>();
+    auto queued = dst->subscribeQueued([](const int&) {}, executor, 1, OverflowPolicy::Fail);
+    dst->set(1);  // Fills the only slot
+
+    int errors = 0;
+    auto src = createAtom<int>(0, [&](std::exception_ptr) { errors++; });
+    auto plain = src->subscribe([&](const int& v) { dst->set(v + 100); });
+    auto grouped = src->subscribe([&](const int& v) { dst->set(v + 200); }, std::make_shared<InlineExecutor>());
+    src->set(1);  // Another atom's overflow is not this write's
+    assert(errors == 2);
+    assert(queued.rejected() == 2);
+}
+
+void test_queued_block_waits_for_consumer() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    std::vector<int> received;
+    {
+        auto pool = std::make_shared<ThreadPoolExecutor>(1);
+        auto sub = atom->subscribeQueued([&](const int& v) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            received.push_back(v);
+        }, pool, 4);
+        for (int i = 1; i <= 200; i++) atom->set(i);
+        while (sub.delivered() < 200) std::this_thread::yield();
+        assert(sub.highWaterMark() <= 4);
     }
+    assert(received.size() == 200);
+    for (int i = 0; i < 200; i++) assert(received[i] == i + 1);
+}
 
-    std::vector<std::thread> writers;
-    for (int i = 0; i < 5; i++) {
-        writers.emplace_back([&, i]() {
-            for (int j = 0; j < 1000; j++) {
-                atom->set(i * 1000 + j);
-            }
-        });
+void test_queued_single_slot() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    auto executor = std::make_shared<ManualExecutor>();
+    std::vector<int> failed, dropped;
+    auto failSub = atom->subscribeQueued([&](const int& v) { failed.push_back(v); }, executor, 1, OverflowPolicy::Fail);
+    auto dropSub = atom->subscribeQueued([&](const int& v) { dropped.push_back(v); }, executor, 1, OverflowPolicy::DropOldest);
+    atom->set(1);
+    bool threw = false;
+    try {
+        atom->set(2);
+    } catch (const QueueOverflow&) {
+        threw = true;  // The undelivered 1 still holds the only slot
+    }
+    assert(threw);
+    try {
+        atom->set(3);
+    } catch (const QueueOverflow&) {
     }
+    assert(failSub.rejected() == 2 && failSub.depth() == 1);
+    assert(dropSub.dropped() == 2 && dropSub.depth() == 1);
+    executor->runAll();
+    assert((failed == std::vector<int>{1}));
+    assert((dropped == std::vector<int>{3}));
+    failSub.unsubscribe();
+    dropSub.unsubscribe();
 
-    for (auto& t : writers) t.join();
-    done = true;
-    for (auto& t : readers) t.join();
+    std::vector<int> blocked;
+    {
+        auto pool = std::make_shared<ThreadPoolExecutor>(1);
+        auto sub = atom->subscribeQueued([&](const int& v) { blocked.push_back(v); }, pool, 1);
+        for (int i = 1; i <= 100; i++) atom->set(i);
+        while (sub.delivered() < 100) std::this_thread::yield();
+        assert(sub.highWaterMark() == 1);
+    }
+    for (int i = 0; i < 100; i++) assert(blocked[i] == i + 1);
 }
 
-// Test runner
-void run(const char* name, void(*fn)()) {
-    try {
-        fn();
-        std::cout << "  PASS  " << name << std::endl;
-    } catch (const std::exception& e) {
-        std::cout << "  FAIL  " << name << " — " << e.what() << std::endl;
-    } catch (...) {
-        std::cout << "  FAIL  " << name << " — unknown exception" << std::endl;
+void test_queued_concurrent_writers_lose_nothing() {
+    auto atom = createAtom<int, IdentityEquality>(0, testErrorHandler);
+    std::atomic<int> received{0};
+    {
+        auto pool = std::make_shared<ThreadPoolExecutor>(1);
+        auto sub = atom->subscribeQueued([&](const int&) { received++; }, pool, 16);
+        std::vector<std::thread> writers;
+        for (int t = 0; t < 4; t++) {
+            writers.emplace_back([&] { for (int i = 0; i < 500; i++) atom->set(i); });
+        }
+        for (auto& w : writers) w.join();
+        while (sub.delivered() < 2000) std::this_thread::yield();
     }
+    assert(received == 2000);
 }
 
-int main() {
-    std::cout << "\n=== Atom Tests ===" << std::endl;
+// Coroutines
+// Fire-and-forget coroutine that starts eagerly.
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
 
-    std::cout << "\n--- General ---" << std::endl;
-    run("initial value", test_initial_value);
-    run("set and get", test_set_and_get);
-    run("update", test_update);
-    run("multiple updates", test_multiple_updates);
+void test_co_await_changed() {
+    auto atom = createAtom<std::string>("a", testErrorHandler);
+    std::vector<std::string> seen;
+    [](std::shared_ptr<Atom<std::string>> atom, std::vector<std::string>& seen) -> Detached {
+        seen.push_back(co_await atom->changed());
+        seen.push_back(co_await atom->changed());
+    }(atom, seen);
+    assert(seen.empty());
+    atom->set("b");
+    assert((seen == std::vector<std::string>{"b"}));
+    atom->set("b");  // Skipped as equal, so no wake
+    atom->set("c");
+    assert((seen == std::vector<std::string>{"b", "c"}));
+}
 
-    std::cout << "\n--- Subscription ---" << std::endl;
-    run("subscribe fires", test_subscribe_fires);
-    run("subscribe fires on update", test_subscribe_fires_on_update);
-    run("multiple subscribers", test_multiple_subscribers);
+void test_changed_resumes_on_executor() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    auto executor = std::make_shared<ManualExecutor>();
+    int seen = -1;
+    [](std::shared_ptr<Atom<int>> atom, std::shared_ptr<Executor> executor, int& seen) -> Detached {
+        seen = co_await atom->changed(executor);
+    }(atom, executor, seen);
+    atom->set(7);
+    assert(seen == -1 && executor->tasks.size() == 1);
+    executor->runAll();
+    assert(seen == 7);
+}
 
-    std::cout << "\n--- Unsubscribe ---" << std::endl;
-    run("raii unsubscribe", test_raii_unsubscribe);
-    run("manual unsubscribe", test_manual_unsubscribe);
-    run("double unsubscribe", test_double_unsubscribe);
-    run("move subscription", test_move_subscription);
-    run("move assign subscription", test_move_assign_subscription);
+void test_conflated_stream() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    auto stream = atom->conflatedChanges();
+    std::vector<int> seen;
+    bool finished = false;
+    [](Atom<int>::ConflatedStream& stream, std::vector<int>& seen, bool& finished) -> Detached {
+        for (int i = 0; i < 2; i++) seen.push_back(*co_await stream.next());
+        finished = true;
+    }(stream, seen, finished);
+    atom->set(1);
+    assert(!finished);
+    atom->set(2);
+    assert(finished);
+    assert((seen == std::vector<int>{1, 2}));
+    stream.close();
 
-    std::cout << "\n--- Equality skip ---" << std::endl;
-    run("skip equal set", test_skip_equal_set);
-    run("skip equal update", test_skip_equal_update);
+    // Values committed while nobody awaits are conflated to the latest.
+    auto later = atom->conflatedChanges();
+    atom->set(4);
+    atom->set(5);
+    int latest = -1;
+    [](Atom<int>::ConflatedStream& stream, int& latest) -> Detached {
+        latest = *co_await stream.next();
+    }(later, latest);
+    assert(latest == 5);
+}
 
-    std::cout << "\n--- Type issues ---" << std::endl;
-    run("string atom", test_string_atom);
-    run("vector atom", test_vector_atom);
+void test_conflated_stream_close_ends_waiter() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    auto stream = atom->conflatedChanges();
+    std::vector<int> seen;
+    bool ended = false;
+    [](Atom<int>::ConflatedStream& stream, std::vector<int>& seen, bool& ended) -> Detached {
+        while (auto v = co_await stream.next()) seen.push_back(*v);
+        ended = true;
+    }(stream, seen, ended);
+    atom->set(1);
+    assert(!ended);
+    stream.close();  // Resumes the suspended coroutine with no value
+    assert(ended);
+    assert((seen == std::vector<int>{1}));
+    atom->set(2);
+    assert(seen.size() == 1);
+}
 
-    std::cout << "\n--- Exceptions ---" << std::endl;
-    run("throwing callback", test_throwing_callback_doesnt_kill_others);
-    run("error handler receives", test_error_handler_receives_exception);
+void test_changed_across_threads() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    std::atomic<int> resumes{0};
+    std::atomic<bool> done{false};
+    {
+        auto pool = std::make_shared<ThreadPoolExecutor>(2);
+        [](std::shared_ptr<Atom<int>> atom, std::shared_ptr<Executor> pool, std::atomic<int>& resumes, std::atomic<bool>& done) -> Detached {
+            while (co_await atom->changed(pool) < 100) resumes++;
+            done = true;
+        }(atom, pool, resumes, done);
+        std::thread writer([&] {
+            for (int i = 1; !done; i++) atom->set(i);
+        });
+        writer.join();
+    }
+    assert(done && resumes > 0);
+}
 
-    std::cout << "\n--- Lifetime ---" << std::endl;
-    run("subscription outlives atom", test_subscription_outlives_atom);
+// Waiting
+void test_wait_until_already_true() {
+    auto atom = createAtom<int>(3, testErrorHandler);
+    assert(atom->waitUntil([](const int& v) { return v == 3; }, std::chrono::milliseconds(0)));
+}
+
+void test_wait_until_times_out() {
+    auto atom = createAtom<std::string>("a", testErrorHandler);
+    auto start = std::chrono::steady_clock::now();
+    assert(!atom->waitUntil([](const std::string& v) { return v == "b"; }, std::chrono::milliseconds(20)));
+    assert(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+}
+
+void test_wait_until_each_strategy() {
+    for (auto strategy : {WaitStrategy::Park, WaitStrategy::Spin, WaitStrategy::SpinThenPark}) {
+        auto atom = createAtom<int>(0, testErrorHandler);
+        std::thread writer([&] {
+            for (int i = 1; i <= 5; i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                atom->set(i);
+            }
+        });
+        assert(atom->waitUntil([](const int& v) { return v == 5; }, std::chrono::nanoseconds::max(), strategy));
+        writer.join();
+    }
+}
+
+// Executors
+void test_inline_executor_subscription() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    auto executor = std::make_shared<InlineExecutor>();
+    int received = -1;
+    auto sub = atom->subscribe([&](const int& v) { received = v; }, executor);
+    atom->set(3);
+    assert(received == 3);
+    sub.unsubscribe();
+    atom->set(4);
+    assert(received == 3);
+}
+
+void test_null_executor_subscription_is_inline() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    int received = -1;
+    auto sub = atom->subscribe([&](const int& v) { received = v; }, nullptr);
+    atom->set(3);
+    assert(received == 3);
+    sub.unsubscribe();
+    atom->set(4);
+    assert(received == 3);
+}
+
+void test_thread_pool_preserves_per_subscriber_order() {
+    auto atom = createAtom<std::string>("", testErrorHandler);
+    std::vector<std::string> a, b;
+    std::atomic<int> delivered{0};
+    {
+        auto pool = std::make_shared<ThreadPoolExecutor>(4);
+        auto subA = atom->subscribe([&](const std::string& v) { a.push_back(v); delivered++; }, pool);
+        auto subB = atom->subscribe([&](const std::string& v) { b.push_back(v); delivered++; }, pool);
+        for (int i = 0; i < 200; i++) atom->set(std::to_string(i));
+        while (delivered < 400) std::this_thread::yield();
+    }
+    assert(a.size() == 200 && a == b);
+    for (int i = 0; i < 200; i++) assert(a[i] == std::to_string(i));
+}
+
+// Pool that reports when its destructor starts.
+template <typename Pool>
+struct TrackedPool : Pool {
+    TrackedPool(size_t threads, std::atomic<bool>& destroyed) : Pool(threads), destroyed(destroyed) {}
+    ~TrackedPool() override { destroyed = true; }
+    std::atomic<bool>& destroyed;
+};
+
+// Waits for a pool released by its own worker, then gives its destructor time
+// to finish; a self-join would terminate the process here.
+void awaitPoolDestroyed(const std::atomic<bool>& destroyed) {
+    while (!destroyed) std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+
+void test_pool_destroyed_by_its_own_task() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    std::atomic<int> stage{0};
+    auto hold = [&](const int&) {
+        stage = 1;
+        while (stage != 2) std::this_thread::yield();
+    };
+
+    std::atomic<bool> threadPool{false};
+    {
+        auto sub = atom->subscribe(hold, std::make_shared<TrackedPool<ThreadPoolExecutor>>(2, threadPool));
+        atom->set(1);
+        while (stage != 1) std::this_thread::yield();
+    }  // Unsubscribed mid-delivery: the drain task holds the last reference
+    stage = 2;
+    awaitPoolDestroyed(threadPool);
+
+    stage = 0;
+    std::atomic<bool> stealingPool{false};
+    {
+        auto sub = atom->subscribeConflated(hold, std::make_shared<TrackedPool<WorkStealingPool>>(1, stealingPool));
+        atom->set(2);
+        while (stage != 1) std::this_thread::yield();
+    }
+    stage = 2;
+    awaitPoolDestroyed(stealingPool);
+
+    std::atomic<bool> coroutinePool{false};
+    [](std::shared_ptr<Atom<int>> atom, std::shared_ptr<Executor> executor) -> Detached {
+        co_await atom->changed(std::move(executor));  // The frame ends on the pool's worker
+    }(atom, std::make_shared<TrackedPool<ThreadPoolExecutor>>(1, coroutinePool));
+    atom->set(3);
+    awaitPoolDestroyed(coroutinePool);
+}
+
+// Static atom
+std::vector<std::string> staticCalls;
+void staticFirst(const int& v) noexcept { staticCalls.push_back("first " + std::to_string(v)); }
+void staticThrows(const int& v) {
+    if (v == 2) throw std::runtime_error("static listener");
+    staticCalls.push_back("throws " + std::to_string(v));
+}
+
+void test_static_atom_calls_listeners_in_order() {
+    staticCalls.clear();
+    int errors = 0;
+    StaticAtom<int, &staticFirst, &staticThrows, [](const int& v) noexcept { staticCalls.push_back("last " + std::to_string(v)); }>
+        atom(0, [&](std::exception_ptr) { errors++; });
+    static_assert(!decltype(atom)::nothrowNotify);
+    atom.set(1);
+    atom.set(1);  // Equal, skipped
+    atom.set(2);
+    atom.update([](const int& v) { return v + 1; });
+    assert(atom.get() == 3);
+    assert((staticCalls == std::vector<std::string>{"first 1", "throws 1", "last 1", "first 2", "last 2", "first 3", "throws 3", "last 3"}));
+    assert(errors == 1);
+}
+
+void test_static_atom_nothrow_fast_path() {
+    staticCalls.clear();
+    StaticAtom<int, &staticFirst> atom(0);
+    static_assert(decltype(atom)::nothrowNotify);
+    atom.set(4);
+    assert((staticCalls == std::vector<std::string>{"first 4"}));
+}
+
+// Derived
+void test_derived_is_lazy_and_memoized() {
+    auto price = createAtom<int>(10, testErrorHandler);
+    auto qty = createAtom<int>(2, testErrorHandler);
+    auto total = createDerived([](int p, int q) { return p * q; }, testErrorHandler, price, qty);
+    assert(total->get() == 20);
+    assert(total->get() == 20);
+    assert(total->computations() == 1);
+
+    price->set(11);
+    price->set(12);
+    assert(total->computations() == 1);  // Nobody read it yet
+    assert(total->get() == 24);
+    assert(total->computations() == 2);
+    qty->set(2);  // Equal, no new version
+    assert(total->get() == 24 && total->computations() == 2);
+}
+
+void test_derived_read_in_batch_sees_commit() {
+    auto a = createAtom<int>(1, testErrorHandler);
+    auto d = createDerived([](int v) { return v * 10; }, testErrorHandler, a);
+    int inside = 0;
+    batch([&] {
+        a->set(2);
+        inside = d->get();  // The wave has not run yet
+    });
+    assert(inside == 20);
+    assert(d->get() == 20 && d->computations() == 2);
+}
+
+void test_derived_read_from_earlier_listener() {
+    auto a = createAtom<int>(1, testErrorHandler);
+    std::shared_ptr<Derived<int>> d;
+    int seen = 0;
+    auto sub = a->subscribe([&](const int&) { seen = d->get(); });  // Runs before d's wave
+    d = createDerived([](int v) { return v * 10; }, testErrorHandler, a);
+    a->set(2);
+    assert(seen == 20);
+}
+
+void test_derived_notifies_only_on_changed_result() {
+    auto value = createAtom<int>(1, testErrorHandler);
+    auto parity = createDerived([](int v) { return v % 2; }, testErrorHandler, value);
+    std::vector<int> seen;
+    auto sub = parity->subscribe([&](const int& p) { seen.push_back(p); });
+    value->set(3);  // Recomputed eagerly, same result
+    assert(parity->computations() == 2);
+    value->set(4);
+    assert((seen == std::vector<int>{0}));
+}
+
+void test_derived_self_read_throws() {
+    auto flag = createAtom<bool>(false, testErrorHandler);
+    std::shared_ptr<Derived<int>> self;
+    auto d = createComputed([&] { return flag->get() ? self->get() + 1 : 0; }, testErrorHandler);
+    self = d;
+    flag->set(true);
+    bool threw = false;
+    try {
+        d->get();
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+    flag->set(false);  // Leaves the cycle: the next read recomputes cleanly
+    assert(d->get() == 0);
+}
+
+void test_derived_cycle_throws() {
+    auto flag = createAtom<bool>(false, testErrorHandler);
+    std::shared_ptr<Derived<int>> b;
+    auto a = createComputed([&] { return flag->get() ? b->get() : 0; }, testErrorHandler);
+    b = createComputed([=] { return a->get() + 1; }, testErrorHandler);
+    flag->set(true);
+    bool threw = false;
+    try {
+        a->get();
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    assert(threw);
+}
+
+void test_derived_listener_errors_reach_on_error() {
+    auto a = createAtom<int>(1, testErrorHandler);
+    int errors = 0;
+    auto d = createDerived([](int v) { return v * 2; }, [&](std::exception_ptr) { errors++; }, a);
+    auto sub = d->subscribe([](const int&) { throw std::runtime_error("listener"); });
+    a->set(2);
+    assert(errors == 1);
+}
+
+void test_derived_equality_policy() {
+    auto a = createAtom<int>(1, testErrorHandler);
+    auto parity = createDerived<IdentityEquality>([](int v) { return v % 2; }, testErrorHandler, a);
+    static_assert(std::is_same_v<decltype(parity), std::shared_ptr<Derived<int, IdentityEquality>>>);
+    int count = 0;
+    auto sub = parity->subscribe([&](const int&) { count++; });
+    a->set(3);  // Same parity, but every result counts as a change
+    assert(count == 1);
+}
+
+void test_derived_of_derived() {
+    auto a = createAtom<int>(1, testErrorHandler);
+    auto doubled = createDerived([](int v) { return v * 2; }, testErrorHandler, a);
+    auto label = createDerived([](int v) { return "x" + std::to_string(v); }, testErrorHandler, doubled);
+    std::string seen;
+    auto sub = label->subscribe([&](const std::string& v) { seen = v; });
+    a->set(5);
+    assert(seen == "x10");
+    assert(label->get() == "x10");
+}
+
+void test_derived_diamond_is_glitch_free() {
+    auto a = createAtom<int>(1, testErrorHandler);
+    auto b = createDerived([](int v) { return v + 1; }, testErrorHandler, a);
+    auto c = createDerived([](int v) { return v * 2; }, testErrorHandler, a);
+    bool torn = false;
+    auto d = createDerived([&](int vb, int vc) {
+        if (vc != (vb - 1) * 2) torn = true;
+        return vb + vc;
+    }, testErrorHandler, b, c);
+    std::vector<int> seen;
+    uint64_t computedWhenBNotified = 0;
+    auto subD = d->subscribe([&](const int& v) { seen.push_back(v); });
+    auto subB = b->subscribe([&](const int&) { computedWhenBNotified = d->computations(); });
+
+    auto before = d->computations();
+    a->set(2);
+    assert(!torn);
+    assert(d->computations() == before + 1);  // Once per upstream commit
+    assert((seen == std::vector<int>{7}));
+    assert(computedWhenBNotified == before + 1);  // B's listener ran after D settled
+
+    a->set(5);
+    assert(!torn && d->computations() == before + 2);
+    assert((seen == std::vector<int>{7, 16}));
+}
+
+void test_derived_consistent_for_source_observers() {
+    auto a = createAtom<int>(1, testErrorHandler);
+    std::shared_ptr<Derived<int>> d;
+    std::vector<std::pair<int, int>> seen;  // (a, d) as a's listener saw them
+    auto subA = a->subscribe([&](const int& v) { seen.emplace_back(v, d->get()); });
+    auto b = createDerived([](int v) { return v + 1; }, testErrorHandler, a);
+    auto c = createDerived([](int v) { return v * 2; }, testErrorHandler, a);
+    d = createDerived([](int vb, int vc) { return vb + vc; }, testErrorHandler, b, c);
+    std::vector<int> heard;
+    auto e = createDerived([](int v) { return v * 100; }, testErrorHandler, d);
+    auto subE = e->subscribe([&](const int& v) { heard.push_back(v); });
+
+    a->set(2);  // a's listener recomputes d before the wave reaches it
+    assert((seen == std::vector<std::pair<int, int>>{{2, 7}}));
+    assert((heard == std::vector<int>{700}));  // The wave still reached e
+
+    batch([&] {
+        a->set(3);
+        assert(d->get() == 10 && e->get() == 1000);
+    });
+    assert((seen.back() == std::pair<int, int>{3, 10}));
+    assert((heard == std::vector<int>{700, 1000}));
+}
+
+void test_derived_concurrent_readers() {
+    auto a = createAtom<int>(0, testErrorHandler);
+    auto sum = createDerived([](int v) { return v + 1; }, testErrorHandler, a);
+    std::atomic<int> last{0};
+    auto sub = sum->subscribe([&](const int& v) { last = v; });
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] { for (int i = 1; i <= 1000; i++) a->set(i); });
+    for (int t = 0; t < 3; t++) {
+        threads.emplace_back([&] { for (int i = 0; i < 1000; i++) assert(sum->get() >= 1); });
+    }
+    for (auto& t : threads) t.join();
+    assert(sum->get() == 1001);
+}
+
+void test_computed_tracks_dependencies_per_run() {
+    auto useA = createAtom<bool>(true, testErrorHandler);
+    auto a = createAtom<int>(1, testErrorHandler);
+    auto b = createAtom<int>(2, testErrorHandler);
+    auto pick = createComputed([=] { return useA->get() ? a->get() : b->get(); }, testErrorHandler);
+    assert(pick->get() == 1 && pick->dependencyCount() == 2);
+    b->set(20);  // Not read by the last run
+    assert(pick->get() == 1 && pick->computations() == 1);
+
+    useA->set(false);
+    assert(pick->get() == 20 && pick->dependencyCount() == 2);
+    a->set(10);  // Dropped from the dependencies
+    assert(pick->get() == 20 && pick->computations() == 2);
+    b->set(30);
+    assert(pick->get() == 30 && pick->computations() == 3);
+}
+
+void test_computed_over_derived_updates_height() {
+    auto flag = createAtom<bool>(false, testErrorHandler);
+    auto a = createAtom<int>(1, testErrorHandler);
+    auto doubled = createComputed([=] { return a->get() * 2; }, testErrorHandler);
+    bool torn = false;
+    auto both = createComputed([=, &torn] {
+        if (!flag->get()) return a->get();
+        if (doubled->get() != a->get() * 2) torn = true;
+        return a->get() + doubled->get();
+    }, testErrorHandler);
+    std::vector<int> seen;
+    auto sub = both->subscribe([&](const int& v) { seen.push_back(v); });
+    flag->set(true);  // Now also reads doubled, one level up
+    a->set(2);
+    assert(!torn);
+    assert((seen == std::vector<int>{3, 6}));
+}
+
+// Parallel fan-out
+void test_parallel_notify_reaches_every_listener() {
+    std::atomic<int> errors{0};
+    auto atom = createAtom<int>(0, [&](std::exception_ptr) { errors++; });
+    atom->parallelNotify(std::make_shared<WorkStealingPool>(4), 100, 16);
+    std::vector<std::atomic<int>> seen(1000);
+    std::vector<Subscription<int>> subs;
+    for (size_t i = 0; i < seen.size(); i++) {
+        subs.push_back(atom->subscribe([&, i](const int& v) {
+            if (i % 100 == 0) throw std::runtime_error("boom");
+            seen[i] += v;
+        }));
+    }
+    atom->set(1);
+    atom->set(2);
+    // set() returns only after every chunk has run.
+    for (size_t i = 0; i < seen.size(); i++) assert(seen[i] == (i % 100 == 0 ? 0 : 3));
+    assert(errors == 20);
+}
+
+void test_parallel_notify_below_threshold_stays_serial() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    atom->parallelNotify(std::make_shared<WorkStealingPool>(2), 100);
+    std::vector<std::thread::id> threads;
+    std::vector<Subscription<int>> subs;
+    for (int i = 0; i < 10; i++) subs.push_back(atom->subscribe([&](const int&) { threads.push_back(std::this_thread::get_id()); }));
+    atom->set(1);
+    assert(threads.size() == 10);
+    for (auto id : threads) assert(id == std::this_thread::get_id());
+}
+
+void test_parallel_notify_releases_replaced_pool() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    auto first = std::make_shared<WorkStealingPool>(2);
+    std::weak_ptr<WorkStealingPool> firstWeak = first;
+    atom->parallelNotify(std::move(first), 1);
+    auto second = std::make_shared<WorkStealingPool>(2);
+    std::weak_ptr<WorkStealingPool> secondWeak = second;
+    atom->parallelNotify(std::move(second), 1);
+    assert(firstWeak.expired());
+    atom->parallelNotify(nullptr);
+    assert(secondWeak.expired());
+    int seen = 0;
+    auto sub = atom->subscribe([&](const int& v) { seen = v; });
+    atom->set(3);  // Serial again
+    assert(seen == 3);
+}
+
+void test_work_stealing_pool_nested_parallel_for() {
+    WorkStealingPool pool(2);
+    std::atomic<int> sum{0};
+    pool.parallelFor(8, 1, [&](size_t, size_t) {
+        pool.parallelFor(100, 10, [&](size_t begin, size_t end) { sum += static_cast<int>(end - begin); });
+    });
+    assert(sum == 800);
+}
+
+// Batch
+void test_batch_coalesces_notifications() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    int count = 0, received = -1;
+    auto sub = atom->subscribe([&](const int& v) { count++; received = v; });
+    batch([&] {
+        atom->set(1);
+        atom->set(2);
+        atom->update([](const int& v) { return v + 1; });
+        assert(atom->get() == 3);  // Writes are visible inside the batch
+        assert(count == 0);
+    });
+    assert(count == 1);
+    assert(received == 3);
+}
+
+void test_batch_skips_unchanged() {
+    auto atom = createAtom<std::string>("a", testErrorHandler);
+    int count = 0;
+    auto sub = atom->subscribe([&](const std::string&) { count++; });
+    {
+        Batch scope;
+        atom->set("b");
+        atom->set("a");
+    }
+    assert(count == 0);
+}
+
+void test_nested_batch_and_multiple_atoms() {
+    auto a = createAtom<int>(0, testErrorHandler);
+    auto b = createAtom<std::string>("", testErrorHandler);
+    std::vector<std::string> order;
+    auto subA = a->subscribe([&](const int&) { order.push_back("a"); });
+    auto subB = b->subscribe([&](const std::string&) { order.push_back("b"); });
+    {
+        Batch outer;
+        a->set(1);
+        {
+            Batch inner;
+            b->set("x");
+            a->set(2);
+        }
+        assert(order.empty());  // Inner batch end does not flush
+    }
+    assert((order == std::vector<std::string>{"a", "b"}));
+}
+
+// Transactions
+void test_transaction_commits_both() {
+    auto a = createAtom<int>(10, testErrorHandler);
+    auto b = createAtom<std::string>("x", testErrorHandler);
+    int seenA = -1;
+    std::string seenB;
+    auto sub = a->subscribe([&](const int& v) { seenA = v; seenB = b->get(); });
+    atomically([&](Transaction& tx) {
+        tx.write(a, tx.read(a) + 1);
+        tx.write(b, tx.read(b) + "y");
+        assert(tx.read(a) == 11);  // Reads see the transaction's own writes
+        assert(a->get() == 10);    // Nothing visible before commit
+    });
+    assert(a->get() == 11);
+    assert(b->get() == "xy");
+    assert(seenA == 11);
+    assert(seenB == "xy");  // Listeners run after every write landed
+}
+
+// Throws on the second comparison made while armed.
+struct SecondCompareThrows {
+    struct Key {};
+    static inline int armed = 0;
+
+    template <typename T>
+    static Key key(const T&) { return {}; }
+
+    template <typename T>
+    static bool same(const T& a, Key, const T& b, Key) {
+        if (armed > 0 && ++armed == 3) throw std::runtime_error("compare failed");
+        return a == b;
+    }
+};
+
+void test_transaction_failed_install_is_stamped() {
+    auto a = createAtom<std::string, SecondCompareThrows>("a0", testErrorHandler);
+    auto b = createAtom<std::string, SecondCompareThrows>("b0", testErrorHandler);
+    int attempts = 0;
+    auto seen = atomically([&](Transaction& tx) {
+        if (attempts++ == 0) {
+            SecondCompareThrows::armed = 1;
+            bool threw = false;
+            try {
+                atomically([&](Transaction& inner) {
+                    inner.write(a, "a1");
+                    inner.write(b, "b1");
+                });
+            } catch (const std::runtime_error&) {
+                threw = true;
+            }
+            SecondCompareThrows::armed = 0;
+            assert(threw);
+        }
+        return tx.read(a) + tx.read(b);
+    });
+    // One of the two writes was installed before the other threw. The outer
+    // transaction began before that and must not read it unnoticed.
+    assert(attempts == 2);
+    assert(seen == "a1b0" || seen == "a0b1");
+}
+
+void test_transaction_returns_value() {
+    auto a = createAtom<int>(3, testErrorHandler);
+    int doubled = atomically([&](Transaction& tx) { return tx.read(a) * 2; });
+    assert(doubled == 6);
+}
+
+// Collections
+void test_vector_deltas_rebuild_replica() {
+    auto vec = createAtomVector<int>({1, 2, 3}, testErrorHandler);
+    std::vector<int> replica = vec->get();
+    int resets = 0;
+    auto sub = vec->subscribeDelta([&](const AtomVector<int>::DeltaType& delta) {
+        if (delta.reset) { resets++; replica = *delta.items; return; }
+        for (const auto& op : *delta.ops) {
+            if (op.op == DeltaOp::Insert) replica.insert(replica.begin() + op.key, *op.value);
+            if (op.op == DeltaOp::Erase) replica.erase(replica.begin() + op.key);
+            if (op.op == DeltaOp::Assign) replica[op.key] = *op.value;
+        }
+    });
+    vec->pushBack(4);
+    vec->insert(0, 0);
+    vec->erase(2);
+    vec->assign(1, 10);
+    vec->assign(1, 10);  // Equal, no delta
+    bool threw = false;
+    try {
+        vec->apply({{DeltaOp::Insert, 0, 7}, {DeltaOp::Erase, 99, std::nullopt}});
+    } catch (const std::out_of_range&) {
+        threw = true;  // Neither op committed
+    }
+    assert(threw);
+    vec->apply({{DeltaOp::Insert, 0, -1}, {DeltaOp::Erase, 4, std::nullopt}});
+    assert(resets == 0);
+    assert(replica == vec->get());
+    assert((replica == std::vector<int>{-1, 0, 10, 3}));
+}
+
+void test_delta_op_without_value_throws() {
+    auto vec = createAtomVector<int>({1, 2}, testErrorHandler);
+    auto map = createAtomMap<std::string, int>({{"a", 1}}, testErrorHandler);
+    int threw = 0;
+    try {
+        vec->apply({{DeltaOp::Erase, 0, std::nullopt}, {DeltaOp::Assign, 0, std::nullopt}});
+    } catch (const std::invalid_argument&) {
+        threw++;
+    }
+    try {
+        map->apply({{DeltaOp::Erase, "a", std::nullopt}, {DeltaOp::Insert, "b", std::nullopt}});
+    } catch (const std::invalid_argument&) {
+        threw++;
+    }
+    assert(threw == 2);
+    assert((vec->get() == std::vector<int>{1, 2}));  // Nothing committed
+    assert(map->size() == 1 && map->get().at("a") == 1);
+}
+
+void test_vector_push_back_racing_erase() {
+    auto vec = createAtomVector<int>(std::vector<int>(3000, 0), testErrorHandler);
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] { for (int i = 1; i <= 1000; i++) vec->pushBack(i); });
+    for (int t = 0; t < 3; t++) {
+        threads.emplace_back([&] { for (int i = 0; i < 1000; i++) vec->erase(0); });
+    }
+    for (auto& t : threads) t.join();
+    std::vector<int> expected(1000);
+    std::iota(expected.begin(), expected.end(), 1);
+    assert(vec->get() == expected);  // No append lost to a stale end index
+}
+
+void test_delta_outlives_its_version() {
+    auto vec = createAtomVector<int>({}, testErrorHandler);
+    std::optional<AtomVector<int>::DeltaType> kept;
+    auto sub = vec->subscribeDelta([&](const AtomVector<int>::DeltaType& delta) { kept = delta; });
+    vec->pushBack(1);
+    vec->pushBack(2);  // Releases the version the first delta came from
+    auto first = kept;
+    vec->pushBack(3);
+    assert(first->ops->size() == 1 && first->ops->front().key == 1 && *first->ops->front().value == 2);
+}
+
+void test_delta_subscriber_writes_reentrantly() {
+    auto vec = createAtomVector<int>({}, testErrorHandler);
+    std::vector<size_t> sizes;
+    auto sub = vec->subscribeDelta([&](const AtomVector<int>::DeltaType& delta) {
+        sizes.push_back(delta.items->size());
+        if (delta.items->size() < 3) vec->pushBack(1);  // Nested notification, same thread
+    });
+    vec->pushBack(0);
+    assert((sizes == std::vector<size_t>{1, 2, 3}));
+    assert((vec->get() == std::vector<int>{0, 1, 1}));
+}
+
+void test_map_deltas_and_batch_reset() {
+    auto map = createAtomMap<std::string, int>({{"a", 1}}, testErrorHandler);
+    std::vector<DeltaOp> seen;
+    bool reset = false;
+    auto sub = map->subscribeDelta([&](const AtomMap<std::string, int>::DeltaType& delta) {
+        reset = delta.reset;
+        for (const auto& op : *delta.ops) seen.push_back(op.op);
+    });
+    map->set("b", 2);
+    map->set("a", 5);
+    map->erase("missing");
+    map->erase("b");
+    assert((seen == std::vector<DeltaOp>{DeltaOp::Insert, DeltaOp::Assign, DeltaOp::Erase}));
+    assert(!reset);
+
+    batch([&] {
+        map->set("c", 3);
+        map->set("d", 4);
+    });
+    assert(reset);  // Coalesced deliveries resynchronise from items
+    assert(map->size() == 3);
+}
+
+// Persistent
+void test_persistent_map_matches_std_map() {
+    PersistentMap<int, int> map;
+    std::map<int, int> expected;
+    std::vector<PersistentMap<int, int>> versions;
+    for (int i = 0; i < 20000; i++) {
+        int key = (i * 7919) % 5000;
+        map = map.set(key, i);
+        expected[key] = i;
+        if (i % 3 == 0) {
+            map = map.erase((i * 31) % 5000);
+            expected.erase((i * 31) % 5000);
+        }
+        if (i % 5000 == 0) versions.push_back(map);
+    }
+    assert(map.size() == expected.size());
+    for (const auto& [k, v] : expected) assert(map.at(k) == v);
+    size_t visited = 0;
+    map.forEach([&](const int& k, const int& v) { visited++; assert(expected.at(k) == v); });
+    assert(visited == expected.size());
+    assert(versions.front().empty());  // Old versions are untouched
+}
+
+struct BadHash {
+    size_t operator()(int) const { return 42; }
+};
+
+void test_persistent_map_collisions() {
+    PersistentMap<int, int, BadHash> map;
+    for (int i = 0; i < 10; i++) map = map.set(i, i * i);
+    map = map.erase(3);
+    assert(map.size() == 9);
+    assert(!map.contains(3));
+    assert(map.at(9) == 81);
+}
+
+void test_persistent_vector_matches_std_vector() {
+    PersistentVector<int> vec;
+    std::vector<int> expected;
+    for (int i = 0; i < 40000; i++) {
+        vec = vec.pushBack(i);
+        expected.push_back(i);
+    }
+    auto before = vec;
+    for (int i = 0; i < 40000; i += 97) {
+        vec = vec.set(i, -i);
+        expected[i] = -i;
+    }
+    for (int i = 0; i < 33000; i++) {
+        vec = vec.popBack();
+        expected.pop_back();
+    }
+    assert(vec.toVector() == expected);
+    assert(before.size() == 40000 && before[97] == 97);  // Structural sharing left it intact
+    assert(!(before == vec));
+}
+
+void test_persistent_atom_skips_on_identity() {
+    PersistentMap<std::string, int> routes;
+    for (int i = 0; i < 1000; i++) routes = routes.set("r" + std::to_string(i), i);
+    auto atom = createAtom<PersistentMap<std::string, int>>(routes, testErrorHandler);
+    int count = 0;
+    auto sub = atom->subscribe([&](const PersistentMap<std::string, int>&) { count++; });
+    atom->update([](const PersistentMap<std::string, int>& m) { return m.set("r5", 5); });  // Same root
+    assert(count == 0);
+    atom->update([](const PersistentMap<std::string, int>& m) { return m.set("r5", 6); });
+    assert(count == 1);
+    assert(atom->get().at("r5") == 6);
+    assert(routes.at("r5") == 5);
+}
+
+// Seqlock
+struct Quote {
+    int64_t bid;
+    int64_t ask;
+    int64_t size;
+    bool operator==(const Quote&) const = default;
+};
+
+void test_seqlock_selected_for_pod() {
+    static_assert(detail::useSeqlock<Quote>);
+    static_assert(!detail::useSeqlock<std::string>);
+    auto atom = createAtom<Quote>({1, 2, 3}, testErrorHandler);
+    Quote received{};
+    auto sub = atom->subscribe([&](const Quote& q) { received = q; });
+    atom->update([](const Quote& q) { return Quote{q.bid + 1, q.ask + 1, q.size}; });
+    assert((atom->get() == Quote{2, 3, 3}));
+    assert((received == Quote{2, 3, 3}));
+    assert((*atom->snapshot() == Quote{2, 3, 3}));
+}
+
+// Lock-free
+void test_atomic_selected_for_scalars() {
+    static_assert(detail::useAtomic<int64_t>);
+    static_assert(detail::useAtomic<double>);
+    static_assert(detail::useAtomic<int*>);
+    static_assert(!detail::useAtomic<Quote>);
+    auto atom = createAtom<double>(1.5, testErrorHandler);
+    int count = 0;
+    auto sub = atom->subscribe([&](const double&) { count++; });
+    atom->set(1.5);
+    atom->update([](const double& v) { return v * 2; });
+    assert(atom->get() == 3.0);
+    assert(count == 1);
+}
+
+// Concurrency
+void test_concurrent_writes() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    std::atomic<int> notifications{0};
+    auto sub = atom->subscribe([&](const int&) { notifications++; });
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 10; i++) {
+        threads.emplace_back([&, i]() {
+            for (int j = 0; j < 1000; j++) {
+                atom->set(i * 1000 + j);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    // No crashes, no deadlocks
+}
+
+void test_concurrent_subscribe_unsubscribe() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < 10; i++) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 100; j++) {
+                auto sub = atom->subscribe([](const int&) {});
+                atom->set(j);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+}
+
+void test_concurrent_reads_and_writes() {
+    auto atom = createAtom<int>(0, testErrorHandler);
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 5; i++) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                volatile int v = atom->get();
+                (void)v;
+            }
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 5; i++) {
+        writers.emplace_back([&, i]() {
+            for (int j = 0; j < 1000; j++) {
+                atom->set(i * 1000 + j);
+            }
+        });
+    }
+
+    for (auto& t : writers) t.join();
+    done = true;
+    for (auto& t : readers) t.join();
+}
+
+void test_concurrent_snapshot_reads() {
+    auto atom = createAtom<std::vector<int>>({0, 0, 0, 0}, testErrorHandler);
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 5; i++) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                auto snap = atom->snapshot();
+                // Every published version is internally consistent
+                for (int v : *snap) assert(v == (*snap)[0]);
+            }
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 5; i++) {
+        writers.emplace_back([&, i]() {
+            for (int j = 0; j < 1000; j++) {
+                int v = i * 1000 + j;
+                atom->set({v, v, v, v});
+            }
+        });
+    }
+
+    for (auto& t : writers) t.join();
+    done = true;
+    for (auto& t : readers) t.join();
+}
+
+void test_concurrent_seqlock_no_torn_reads() {
+    auto atom = createAtom<Quote>({0, 0, 0}, testErrorHandler);
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 5; i++) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                auto q = atom->get();
+                assert(q.bid == q.ask && q.ask == q.size);
+            }
+        });
+    }
+
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 5; i++) {
+        writers.emplace_back([&, i]() {
+            for (int j = 0; j < 1000; j++) {
+                int64_t v = i * 1000 + j;
+                atom->set({v, v, v});
+            }
+        });
+    }
+
+    for (auto& t : writers) t.join();
+    done = true;
+    for (auto& t : readers) t.join();
+}
+
+void test_concurrent_atomic_updates() {
+    auto atom = createAtom<int64_t>(0, testErrorHandler);
+    std::atomic<int> notifications{0};
+    auto sub = atom->subscribe([&](const int64_t&) { notifications++; });
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 10; i++) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 1000; j++) {
+                atom->update([](const int64_t& v) { return v + 1; });
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    assert(atom->get() == 10000);  // No lost updates
+    assert(notifications == 10000);
+}
+
+template <typename T, typename F>
+void hammerOptimistic(T initial, F step, const T& expected) {
+    auto atom = createAtom<T>(initial, testErrorHandler);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 500; j++) {
+                atom->updateOptimistic(step);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    assert(atom->get() == expected);  // No lost updates
+    auto stats = atom->optimisticStats();
+    assert(stats.commits == 4000);
+    assert(stats.retries >= stats.conflicts);
+}
+
+void test_concurrent_optimistic_updates() {
+    hammerOptimistic<int64_t>(0, [](const int64_t& v) { return v + 1; }, 4000);
+    hammerOptimistic<Quote>({0, 0, 0}, [](const Quote& q) { return Quote{q.bid + 1, q.ask, q.size}; }, {4000, 0, 0});
+    hammerOptimistic<std::string>("", [](const std::string& s) { return s + "x"; }, std::string(4000, 'x'));
+}
+
+void test_concurrent_combining_updates() {
+    auto atom = createAtom<std::vector<int>>({0, 0}, testErrorHandler);
+    std::atomic<int> notifications{0};
+    auto sub = atom->subscribe([&](const std::vector<int>&) { notifications++; });
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 500; j++) {
+                atom->updateCombining([](const std::vector<int>& v) { return std::vector<int>{v[0] + 1, v[1] + 2}; });
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    assert((atom->get() == std::vector<int>{4000, 8000}));
+    assert(notifications <= 4000);  // Batches coalesce into one wave each
+}
+
+void test_concurrent_transfers() {
+    auto a = createAtom<int64_t>(1000, testErrorHandler);
+    auto b = createAtom<int64_t>(1000, testErrorHandler);
+    auto c = createAtom<int64_t>(1000, testErrorHandler);
+    std::atomic<bool> done{false};
+
+    std::thread auditor([&]() {
+        while (!done) {
+            auto total = atomically([&](Transaction& tx) { return tx.read(a) + tx.read(b) + tx.read(c); });
+            assert(total == 3000);  // Never observes a half-applied transfer
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 6; i++) {
+        threads.emplace_back([&, i]() {
+            auto& from = i % 3 == 0 ? a : i % 3 == 1 ? b : c;
+            auto& to = i % 3 == 0 ? b : i % 3 == 1 ? c : a;
+            for (int j = 0; j < 500; j++) {
+                atomically([&](Transaction& tx) {
+                    tx.write(from, tx.read(from) - 1);
+                    tx.write(to, tx.read(to) + 1);
+                });
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    done = true;
+    auditor.join();
+    assert(a->get() + b->get() + c->get() == 3000);
+}
+
+// Executor that runs each task on a thread of its own.
+struct ThreadPerTaskExecutor : Executor {
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    void post(std::function<void()> task) override {
+        std::unique_lock lock(mutex);
+        threads.emplace_back(std::move(task));
+    }
+    void joinAll() {
+        std::unique_lock lock(mutex);
+        for (auto& t : threads) t.join();
+    }
+};
+
+void test_concurrent_conflated_delivery() {
+    auto atom = createAtom<int64_t>(0, testErrorHandler);
+    auto executor = std::make_shared<ThreadPerTaskExecutor>();
+    std::atomic<int64_t> last{0};
+    std::atomic<bool> inCallback{false};
+    auto sub = atom->subscribeConflated(
+        [&](const int64_t& v) {
+            assert(!inCallback.exchange(true));  // Deliveries never overlap
+            last = v;
+            inCallback = false;
+        },
+        executor);
+
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 4; i++) {
+        writers.emplace_back([&]() {
+            for (int j = 0; j < 1000; j++) atom->update([](const int64_t& v) { return v + 1; });
+        });
+    }
+    for (auto& t : writers) t.join();
+    executor->joinAll();
+    assert(sub.delivered() + sub.conflated() == 4000);  // Every value delivered or counted
+}
+
+void test_concurrent_executor_delivery() {
+    auto pool = std::make_shared<ThreadPoolExecutor>(3);
+    auto atom = createAtom<int64_t>(0, testErrorHandler);
+    std::atomic<int> delivered{0};
+    std::atomic<bool> inCallback{false};
+    auto sub = atom->subscribe([&](const int64_t&) {
+        assert(!inCallback.exchange(true));  // One group never runs concurrently
+        delivered++;
+        inCallback = false;
+    }, pool);
+
+    std::vector<std::thread> writers;
+    for (int i = 0; i < 4; i++) {
+        writers.emplace_back([&]() {
+            for (int j = 0; j < 1000; j++) atom->update([](const int64_t& v) { return v + 1; });
+        });
+    }
+    for (auto& t : writers) t.join();
+    while (delivered < 4000) std::this_thread::yield();
+}
+
+// Test runner
+void run(const char* name, void(*fn)()) {
+    try {
+        fn();
+        std::cout << "  PASS  " << name << std::endl;
+    } catch (const std::exception& e) {
+        std::cout << "  FAIL  " << name << " — " << e.what() << std::endl;
+    } catch (...) {
+        std::cout << "  FAIL  " << name << " — unknown exception" << std::endl;
+    }
+}
+
+int main() {
+    std::cout << "\n=== Atom Tests ===" << std::endl;
+
+    std::cout << "\n--- General ---" << std::endl;
+    run("initial value", test_initial_value);
+    run("set and get", test_set_and_get);
+    run("update", test_update);
+    run("multiple updates", test_multiple_updates);
+    run("update optimistic", test_update_optimistic);
+    run("update combining", test_update_combining);
+    run("update combining rethrows", test_update_combining_rethrows);
+    run("update combining failed publish fails every request", test_update_combining_failed_publish_fails_every_request);
+    run("mutate", test_mutate);
+    run("mutate keeps old snapshot", test_mutate_keeps_old_snapshot);
+
+    std::cout << "\n--- Subscription ---" << std::endl;
+    run("subscribe fires", test_subscribe_fires);
+    run("subscribe fires on update", test_subscribe_fires_on_update);
+    run("multiple subscribers", test_multiple_subscribers);
+
+    std::cout << "\n--- Unsubscribe ---" << std::endl;
+    run("raii unsubscribe", test_raii_unsubscribe);
+    run("manual unsubscribe", test_manual_unsubscribe);
+    run("double unsubscribe", test_double_unsubscribe);
+    run("move subscription", test_move_subscription);
+    run("move assign subscription", test_move_assign_subscription);
+    run("unsubscribe during notify", test_unsubscribe_during_notify);
+    run("unsubscribe reuses slots", test_unsubscribe_reuses_slots);
+    run("many subscribers then unsubscribe", test_many_subscribers_then_unsubscribe);
+    run("unsubscribe across listener chunks", test_unsubscribe_across_listener_chunks);
+    run("unsubscribe across listener pages", test_unsubscribe_across_listener_pages);
+    run("subscribe ref", test_subscribe_ref);
+    run("subscribe ref in flight after unsubscribe", test_subscribe_ref_in_flight_after_unsubscribe);
+    run("inplace function moves target", test_inplace_function_moves_target);
+
+    std::cout << "\n--- Equality skip ---" << std::endl;
+    run("skip equal set", test_skip_equal_set);
+    run("skip equal update", test_skip_equal_update);
+    run("identity equality always notifies", test_identity_equality_always_notifies);
+    run("lock-free skipped write keeps value", test_lock_free_skipped_write_keeps_value);
+    run("field equality compares revision", test_field_equality_compares_revision);
+    run("field equality lock-free", test_field_equality_lock_free);
+    run("hash equality", test_hash_equality);
+    run("hash equality uses carried hash", test_hash_equality_uses_carried_hash);
+
+    std::cout << "\n--- Type issues ---" << std::endl;
+    run("string atom", test_string_atom);
+    run("vector atom", test_vector_atom);
+
+    std::cout << "\n--- Exceptions ---" << std::endl;
+    run("throwing callback", test_throwing_callback_doesnt_kill_others);
+    run("error handler receives", test_error_handler_receives_exception);
+
+    std::cout << "\n--- Lifetime ---" << std::endl;
+    run("subscription outlives atom", test_subscription_outlives_atom);
+
+    std::cout << "\n--- Snapshot ---" << std::endl;
+    run("snapshot reflects value", test_snapshot_reflects_value);
+    run("snapshot shared when unchanged", test_snapshot_shared_when_unchanged);
+    run("subscribe snapshot shares version", test_subscribe_snapshot_shares_version);
+    run("subscribe snapshot inline value", test_subscribe_snapshot_inline_value);
+
+    std::cout << "\n--- Conflation ---" << std::endl;
+    run("conflated delivers latest only", test_conflated_delivers_latest_only);
+    run("conflated inline executor", test_conflated_inline_executor);
+
+    std::cout << "\n--- Queued ---" << std::endl;
+    run("queued delivers every value", test_queued_delivers_every_value);
+    run("queued drop oldest", test_queued_drop_oldest);
+    run("queued fail throws after wave", test_queued_fail_throws_after_wave);
+    run("listener overflow goes to onError", test_listener_overflow_goes_to_on_error);
+    run("queued block waits for consumer", test_queued_block_waits_for_consumer);
+    run("queued single slot", test_queued_single_slot);
+    run("queued concurrent writers lose nothing", test_queued_concurrent_writers_lose_nothing);
+
+    std::cout << "\n--- Coroutines ---" << std::endl;
+    run("co_await changed", test_co_await_changed);
+    run("changed resumes on executor", test_changed_resumes_on_executor);
+    run("conflated stream", test_conflated_stream);
+    run("conflated stream close ends waiter", test_conflated_stream_close_ends_waiter);
+    run("changed across threads", test_changed_across_threads);
+
+    std::cout << "\n--- Waiting ---" << std::endl;
+    run("wait until already true", test_wait_until_already_true);
+    run("wait until times out", test_wait_until_times_out);
+    run("wait until each strategy", test_wait_until_each_strategy);
+
+    std::cout << "\n--- Executors ---" << std::endl;
+    run("inline executor subscription", test_inline_executor_subscription);
+    run("null executor subscription is inline", test_null_executor_subscription_is_inline);
+    run("thread pool preserves per-subscriber order", test_thread_pool_preserves_per_subscriber_order);
+    run("pool destroyed by its own task", test_pool_destroyed_by_its_own_task);
+
+    std::cout << "\n--- Static atom ---" << std::endl;
+    run("static atom calls listeners in order", test_static_atom_calls_listeners_in_order);
+    run("static atom nothrow fast path", test_static_atom_nothrow_fast_path);
+
+    std::cout << "\n--- Derived ---" << std::endl;
+    run("derived is lazy and memoized", test_derived_is_lazy_and_memoized);
+    run("derived read in batch sees commit", test_derived_read_in_batch_sees_commit);
+    run("derived read from earlier listener", test_derived_read_from_earlier_listener);
+    run("derived notifies only on changed result", test_derived_notifies_only_on_changed_result);
+    run("derived self read throws", test_derived_self_read_throws);
+    run("derived cycle throws", test_derived_cycle_throws);
+    run("derived listener errors reach onError", test_derived_listener_errors_reach_on_error);
+    run("derived equality policy", test_derived_equality_policy);
+    run("derived of derived", test_derived_of_derived);
+    run("derived diamond is glitch free", test_derived_diamond_is_glitch_free);
+    run("derived consistent for source observers", test_derived_consistent_for_source_observers);
+    run("derived concurrent readers", test_derived_concurrent_readers);
+    run("computed tracks dependencies per run", test_computed_tracks_dependencies_per_run);
+    run("computed over derived updates height", test_computed_over_derived_updates_height);
+
+    std::cout << "\n--- Parallel fan-out ---" << std::endl;
+    run("parallel notify reaches every listener", test_parallel_notify_reaches_every_listener);
+    run("parallel notify below threshold stays serial", test_parallel_notify_below_threshold_stays_serial);
+    run("parallel notify releases replaced pool", test_parallel_notify_releases_replaced_pool);
+    run("work stealing pool nested parallel for", test_work_stealing_pool_nested_parallel_for);
+
+    std::cout << "\n--- Batch ---" << std::endl;
+    run("batch coalesces notifications", test_batch_coalesces_notifications);
+    run("batch skips unchanged", test_batch_skips_unchanged);
+    run("nested batch and multiple atoms", test_nested_batch_and_multiple_atoms);
+
+    std::cout << "\n--- Transactions ---" << std::endl;
+    run("transaction commits both", test_transaction_commits_both);
+    run("transaction failed install is stamped", test_transaction_failed_install_is_stamped);
+    run("transaction returns value", test_transaction_returns_value);
+
+    std::cout << "\n--- Collections ---" << std::endl;
+    run("vector deltas rebuild replica", test_vector_deltas_rebuild_replica);
+    run("delta op without value throws", test_delta_op_without_value_throws);
+    run("vector push back racing erase", test_vector_push_back_racing_erase);
+    run("delta outlives its version", test_delta_outlives_its_version);
+    run("delta subscriber writes reentrantly", test_delta_subscriber_writes_reentrantly);
+    run("map deltas and batch reset", test_map_deltas_and_batch_reset);
+
+    std::cout << "\n--- Persistent ---" << std::endl;
+    run("persistent map matches std::map", test_persistent_map_matches_std_map);
+    run("persistent map collisions", test_persistent_map_collisions);
+    run("persistent vector matches std::vector", test_persistent_vector_matches_std_vector);
+    run("persistent atom skips on identity", test_persistent_atom_skips_on_identity);
+
+    std::cout << "\n--- Seqlock ---" << std::endl;
+    run("seqlock selected for pod", test_seqlock_selected_for_pod);
+
+    std::cout << "\n--- Lock-free ---" << std::endl;
+    run("atomic selected for scalars", test_atomic_selected_for_scalars);
 
     std::cout << "\n--- Concurrency ---" << std::endl;
     run("concurrent writes", test_concurrent_writes);
     run("concurrent subscribe/unsubscribe", test_concurrent_subscribe_unsubscribe);
     run("concurrent reads and writes", test_concurrent_reads_and_writes);
+    run("concurrent snapshot reads", test_concurrent_snapshot_reads);
+    run("concurrent seqlock reads", test_concurrent_seqlock_no_torn_reads);
+    run("concurrent atomic updates", test_concurrent_atomic_updates);
+    run("concurrent optimistic updates", test_concurrent_optimistic_updates);
+    run("concurrent combining updates", test_concurrent_combining_updates);
+    run("concurrent transfers", test_concurrent_transfers);
+    run("concurrent conflated delivery", test_concurrent_conflated_delivery);
+    run("concurrent executor delivery", test_concurrent_executor_delivery);
 
     std::cout << "\n=== Done ===" << std::endl;
     return 0;